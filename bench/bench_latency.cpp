@@ -0,0 +1,160 @@
+// End-to-end latency of a chat turn against the bundled mock server.
+//
+// Forks a MockOpenRouter (so its allocations are not counted), points ori at
+// it through ORI_API_URL and times two paths:
+//   tui - OriAssistant::processSingleRequest on one growing conversation
+//   gui - POST /api/prompt against an in-process GUI server
+// and reports p50/p95/p99 wall time and heap allocations per turn. GUI
+// allocations include the in-process HTTP client that drives the server.
+//
+// Usage: ori_bench_latency [turns] [mock_latency_ms] [mock_tokens_per_sec]
+
+#include "mock_openrouter.h"
+#include "ori_core.h"
+#include "ori_gui.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::atomic<unsigned long long> g_allocations{0};
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+const int MOCK_PORT = 18181;
+const int GUI_PORT = 18182;
+
+struct Sample {
+    double ms;
+    unsigned long long allocations;
+};
+
+void report(const char* name, std::vector<Sample> samples) {
+    if (samples.empty()) return;
+    std::vector<double> ms;
+    unsigned long long allocations = 0;
+    for (const auto& s : samples) {
+        ms.push_back(s.ms);
+        allocations += s.allocations;
+    }
+    std::sort(ms.begin(), ms.end());
+    auto pct = [&ms](double p) {
+        size_t i = static_cast<size_t>(p * (ms.size() - 1) + 0.5);
+        return ms[std::min(i, ms.size() - 1)];
+    };
+    std::printf("%-4s %6zu %9.2f %9.2f %9.2f %12.0f\n", name, ms.size(), pct(0.50), pct(0.95), pct(0.99),
+                static_cast<double>(allocations) / samples.size());
+}
+
+template <typename F>
+Sample measure(F&& turn) {
+    unsigned long long before = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    turn();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return {ms, g_allocations.load() - before};
+}
+}
+
+int main(int argc, char* argv[]) {
+    int turns = argc > 1 ? std::atoi(argv[1]) : 200;
+    MockOptions options;
+    options.port = MOCK_PORT;
+    options.latency_ms = argc > 2 ? std::atoi(argv[2]) : 5;
+    options.tokens_per_sec = argc > 3 ? std::atof(argv[3]) : 0;
+
+    // Fork before any thread exists; the child only serves the mock
+    pid_t mock_pid = fork();
+    if (mock_pid == 0) {
+        MockOpenRouter mock(options);
+        if (!mock.start()) _exit(1);
+        while (true) pause();
+    }
+    const std::string url = "http://127.0.0.1:" + std::to_string(MOCK_PORT) + "/api/v1/chat/completions";
+
+    // Keep the run away from the user's real config, key and cache
+    char home_template[] = "/tmp/ori-bench-XXXXXX";
+    const char* home = mkdtemp(home_template);
+    if (!home) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    setenv("HOME", home, 1);
+    setenv("OPENROUTER_API_KEY", "bench", 1);
+    setenv("ORI_API_URL", url.c_str(), 1);
+    std::string config_dir = std::string(home) + "/.config/ori";
+    std::system(("mkdir -p " + config_dir).c_str());
+    std::ofstream(config_dir + "/config.json") << "{\"port\": " << GUI_PORT << ", \"prewarm\": false}\n";
+
+    httplib::Client mock_client("127.0.0.1", MOCK_PORT);
+    for (int i = 0; i < 100 && !mock_client.Get("/"); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    std::printf("mock: %s latency=%dms tps=%.0f turns=%d\n", url.c_str(), options.latency_ms,
+                options.tokens_per_sec, turns);
+    std::printf("%-4s %6s %9s %9s %9s %12s\n", "path", "turns", "p50_ms", "p95_ms", "p99_ms", "allocs/turn");
+
+    // TUI path: one conversation, terminal output discarded
+    {
+        OriAssistant assistant;
+        if (!assistant.initialize()) return 1;
+        std::ostringstream sink;
+        std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+        std::vector<Sample> samples;
+        for (int i = 0; i < turns; ++i) {
+            std::string prompt = "benchmark turn " + std::to_string(i);
+            samples.push_back(measure([&]() { assistant.processSingleRequest(prompt, true); }));
+            sink.str("");
+        }
+        std::cout.rdbuf(saved);
+        report("tui", samples);
+    }
+
+    // GUI path: POST /api/prompt to a GUI server in this process
+    {
+        std::thread([]() { ori::start_gui(GUI_PORT); }).detach();
+        httplib::Client gui("127.0.0.1", GUI_PORT);
+        gui.set_read_timeout(30, 0);
+        gui.set_tcp_nodelay(true);
+        bool up = false;
+        for (int i = 0; i < 100 && !(up = static_cast<bool>(gui.Get("/api/version"))); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        std::vector<Sample> samples;
+        for (int i = 0; up && i < turns; ++i) {
+            std::string body = "{\"prompt\": \"benchmark turn " + std::to_string(i) + "\", \"session_id\": \"bench\"}";
+            samples.push_back(measure([&]() { gui.Post("/api/prompt", body, "application/json"); }));
+        }
+        if (up) {
+            report("gui", samples);
+        } else {
+            std::printf("gui    skipped: no GUI server on port %d\n", GUI_PORT);
+        }
+    }
+
+    kill(mock_pid, SIGTERM);
+    waitpid(mock_pid, nullptr, 0);
+    std::system(("rm -rf " + std::string(home)).c_str());
+    std::fflush(stdout);
+    // The GUI server thread never returns; skip static destructors
+    _exit(0);
+}
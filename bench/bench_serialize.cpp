@@ -0,0 +1,91 @@
+// Per-turn request serialization cost as a conversation grows.
+//
+// Simulates a session where every turn adds a large command output (as /cat
+// and [exec] feedback do) plus a short assistant reply, and times building the
+// request body two ways:
+//   rebuild     - the old path: Json::Value tree of the whole history + writeString
+//   incremental - HistorySerializer::sync + RequestBody assembly
+//
+// Usage: ori_bench_serialize [turns] [output_kb]
+
+#include "ori_protocol.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string make_output(size_t bytes, int turn) {
+    std::string out;
+    out.reserve(bytes);
+    while (out.size() < bytes) {
+        out += "drwxr-xr-x 2 user user 4096 \"turn " + std::to_string(turn) + "\" file\tname\n";
+    }
+    out.resize(bytes);
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    int turns = argc > 1 ? std::atoi(argv[1]) : 64;
+    size_t output_kb = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+
+    std::vector<ChatMessage> history;
+    history.emplace_back(ChatRole::System, std::string(6 * 1024, 's'));
+    HistorySerializer serializer;
+    const std::string model = "qwen/qwen3-coder:free";
+
+    std::printf("%6s %12s %14s %16s\n", "turn", "history_kb", "rebuild_us", "incremental_us");
+    for (int turn = 1; turn <= turns; ++turn) {
+        history.emplace_back(ChatRole::User, make_output(output_kb * 1024, turn));
+
+        auto start = std::chrono::steady_clock::now();
+        Json::Value request_data;
+        request_data["model"] = model;
+        Json::Value messages(Json::arrayValue);
+        for (const auto& msg : history) {
+            Json::Value message;
+            message["role"] = chatRoleName(msg.role);
+            message["content"] = msg.content;
+            messages.append(message);
+        }
+        request_data["messages"] = messages;
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        std::string rebuilt = Json::writeString(builder, request_data);
+        double rebuild_us = elapsed_us(start);
+
+        start = std::chrono::steady_clock::now();
+        serializer.sync(history);
+        RequestBody body;
+        std::string head = "{\"model\":";
+        appendJsonString(head, model);
+        head += ",\"messages\":[";
+        body.append(std::move(head));
+        serializer.appendTo(body);
+        body.append("]}");
+        double incremental_us = elapsed_us(start);
+
+        size_t history_bytes = 0;
+        for (const auto& msg : history) history_bytes += msg.content.size();
+        if (turn == 1 || turn % 8 == 0 || turn == turns) {
+            std::printf("%6d %12zu %14.1f %16.1f\n", turn, history_bytes / 1024, rebuild_us, incremental_us);
+        }
+
+        // Sanity check: both bodies must decode to the same document
+        if (turn == turns) {
+            Json::Value a, b;
+            Json::Reader reader;
+            if (!reader.parse(rebuilt, a) || !reader.parse(body.str(), b) || a != b) {
+                std::fprintf(stderr, "incremental body does not match the rebuilt one\n");
+                return 1;
+            }
+        }
+
+        history.emplace_back(ChatRole::Assistant, "Here is a summary of turn " + std::to_string(turn) + ".");
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Wall time of one ori process per command-line mode, cold and warm.
+//
+//   cold - every run gets a fresh, empty HOME (no config, key or caches)
+//   warm - runs share a HOME prepared by an earlier run
+//
+// The one-shot prompt mode talks to an in-process MockOpenRouter with no
+// added latency, so it measures ori's own startup and teardown. The
+// metadata modes run without OPENROUTER_API_KEY: they must neither need
+// the key nor wait for one on stdin.
+//
+// Usage: ori_bench_startup [runs] [path/to/ori]
+
+#include "mock_openrouter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <signal.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef ORI_BINARY
+#define ORI_BINARY "./ori"
+#endif
+
+namespace {
+const int MOCK_PORT = 18183;
+
+struct Mode {
+    const char* name;
+    std::vector<std::string> args;
+    bool needs_key;
+};
+
+// Run ori once with the given HOME; returns wall milliseconds, or -1 if it
+// did not exit with status 0.
+double runOnce(const std::string& binary, const Mode& mode, const std::string& home, const std::string& url) {
+    std::vector<std::string> env = {"HOME=" + home, "PATH=/usr/bin:/bin", "TERM=dumb"};
+    if (mode.needs_key) {
+        env.push_back("OPENROUTER_API_KEY=bench");
+        env.push_back("ORI_API_URL=" + url);
+    }
+    std::vector<char*> envp, argv;
+    for (auto& e : env) envp.push_back(&e[0]);
+    envp.push_back(nullptr);
+    std::string arg0 = binary;
+    argv.push_back(&arg0[0]);
+    std::vector<std::string> args = mode.args;
+    for (auto& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execve(binary.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? ms : -1;
+}
+
+std::string freshHome() {
+    char home_template[] = "/tmp/ori-startup-XXXXXX";
+    const char* home = mkdtemp(home_template);
+    return home ? home : "/tmp";
+}
+
+void report(const char* mode, const char* temperature, std::vector<double> ms, int failures) {
+    if (ms.empty()) {
+        std::printf("%-12s %-5s %6s %9s %9s %9s  %d failed\n", mode, temperature, "0", "-", "-", "-", failures);
+        return;
+    }
+    std::sort(ms.begin(), ms.end());
+    auto pct = [&ms](double p) { return ms[std::min(ms.size() - 1, static_cast<size_t>(p * (ms.size() - 1) + 0.5))]; };
+    std::printf("%-12s %-5s %6zu %9.2f %9.2f %9.2f", mode, temperature, ms.size(), pct(0.0), pct(0.5), pct(0.95));
+    if (failures) std::printf("  %d failed", failures);
+    std::printf("\n");
+}
+}
+
+int main(int argc, char* argv[]) {
+    int runs = argc > 1 ? std::atoi(argv[1]) : 20;
+    std::string binary = argc > 2 ? argv[2] : ORI_BINARY;
+    if (access(binary.c_str(), X_OK) != 0) {
+        std::fprintf(stderr, "Cannot execute %s\n", binary.c_str());
+        return 1;
+    }
+
+    pid_t mock_pid = fork();
+    if (mock_pid == 0) {
+        MockOptions options;
+        options.port = MOCK_PORT;
+        options.latency_ms = 0;
+        options.reply_tokens = 16;
+        MockOpenRouter mock(options);
+        if (!mock.start()) _exit(1);
+        while (true) pause();
+    }
+    const std::string url = "http://127.0.0.1:" + std::to_string(MOCK_PORT) + "/api/v1/chat/completions";
+    httplib::Client probe("127.0.0.1", MOCK_PORT);
+    for (int i = 0; i < 100 && !probe.Get("/"); ++i) usleep(20000);
+
+    const std::vector<Mode> modes = {
+        {"--version", {"--version"}, false},
+        {"--help", {"--help"}, false},
+        {"config-cat", {"--config", "cat", "model"}, false},
+        {"prompt", {"-y", "--no-banner", "say hi"}, true},
+    };
+
+    std::printf("binary: %s, %d runs per row\n", binary.c_str(), runs);
+    std::printf("%-12s %-5s %6s %9s %9s %9s\n", "mode", "temp", "runs", "min_ms", "p50_ms", "p95_ms");
+    std::vector<std::string> homes;
+    for (const auto& mode : modes) {
+        std::vector<double> cold, warm;
+        int cold_failures = 0, warm_failures = 0;
+        for (int i = 0; i < runs; ++i) {
+            homes.push_back(freshHome());
+            double ms = runOnce(binary, mode, homes.back(), url);
+            if (ms < 0) cold_failures++; else cold.push_back(ms);
+        }
+        std::string warm_home = homes.back();
+        for (int i = 0; i < runs; ++i) {
+            double ms = runOnce(binary, mode, warm_home, url);
+            if (ms < 0) warm_failures++; else warm.push_back(ms);
+        }
+        report(mode.name, "cold", cold, cold_failures);
+        report(mode.name, "warm", warm, warm_failures);
+    }
+
+    kill(mock_pid, SIGTERM);
+    waitpid(mock_pid, nullptr, 0);
+    for (const auto& home : homes) {
+        std::system(("rm -rf " + home).c_str());
+    }
+    return 0;
+}
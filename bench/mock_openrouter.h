@@ -0,0 +1,244 @@
+// In-process stand-in for the OpenRouter chat-completions endpoint, built on
+// the vendored cpp-httplib. Used by ori_mock_server and the benchmarks so the
+// request path can be exercised offline and without spending API credits.
+#ifndef ORI_MOCK_OPENROUTER_H
+#define ORI_MOCK_OPENROUTER_H
+
+#include "httplib.h"
+#include <json/json.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct MockOptions {
+    std::string host = "127.0.0.1";
+    int port = 18080;
+    int latency_ms = 50;         // delay before the first byte of every reply
+    double tokens_per_sec = 0;   // streaming pace; 0 sends tokens back to back
+    size_t reply_tokens = 64;    // length of the "text" reply
+    double rate_429 = 0;         // fraction of requests answered 429 with Retry-After
+    double rate_5xx = 0;         // fraction of requests answered 503
+    int retry_after_s = 1;
+    std::string reply = "text";  // text | exec | execs | edit
+    bool accept_gzip = true;     // false answers gzipped requests with 415
+    std::string unix_socket;     // listen on this socket path instead of host:port
+};
+
+class MockOpenRouter {
+public:
+    explicit MockOpenRouter(MockOptions opts) : options(std::move(opts)), rng(12345) {
+        // Small SSE writes must not sit in Nagle's buffer and skew latency numbers
+        server.set_tcp_nodelay(true);
+        server.Post(R"(.*/chat/completions)", [this](const httplib::Request& req, httplib::Response& res) {
+            handle(req, res);
+        });
+    }
+
+    ~MockOpenRouter() { stop(); }
+
+    // Listen on a background thread; returns once the port accepts connections.
+    bool start() {
+        if (!options.unix_socket.empty()) {
+            server.set_address_family(AF_UNIX);
+            unlink(options.unix_socket.c_str());
+            if (!server.bind_to_port(options.unix_socket, 80)) return false;
+        } else if (!server.bind_to_port(options.host, options.port)) {
+            return false;
+        }
+        thread = std::thread([this]() { server.listen_after_bind(); });
+        server.wait_until_ready();
+        return true;
+    }
+
+    void stop() {
+        server.stop();
+        if (thread.joinable()) thread.join();
+    }
+
+    std::string url() const {
+        if (!options.unix_socket.empty()) return "http://localhost/v1/chat/completions via " + options.unix_socket;
+        return "http://" + options.host + ":" + std::to_string(options.port) + "/api/v1/chat/completions";
+    }
+
+    unsigned long long requests() const { return request_count.load(); }
+
+private:
+    std::string replyText(const Json::Value& messages) const {
+        // Command output coming back gets a plain answer, not another round of commands
+        const Json::Value& last = messages[messages.size() - 1];
+        bool command_output = last["content"].isString() && last["content"].asString().find("\n---\n") != std::string::npos;
+        if (options.reply == "exec" && !command_output) {
+            return "Let me check that for you.\n[exec]echo ori-mock[/exec]";
+        }
+        if (options.reply == "execs" && !command_output) {
+            return "Let me look at a few things.\n[exec]sleep 1; echo one[/exec]\n[exec]sleep 1; echo two[/exec]\n"
+                   "[exec]sleep 1; echo three >&2; exit 3[/exec]";
+        }
+        if (options.reply == "edit") {
+            return "Creating the file now.\n[edit]\n{\"operation\": \"create\", \"file\": \"ori-mock.txt\", "
+                   "\"content\": \"written by the mock server\\n\"}\n[/edit]";
+        }
+        std::string text;
+        static const char* const words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "a ", "lazy ", "dog. "};
+        for (size_t i = 0; i < options.reply_tokens; ++i) {
+            text += words[i % (sizeof(words) / sizeof(words[0]))];
+        }
+        return text;
+    }
+
+    // Split a reply into "tokens" of a word (or up to 8 bytes) each
+    static std::vector<std::string> tokenize(const std::string& text) {
+        std::vector<std::string> tokens;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find(' ', pos);
+            end = (end == std::string::npos) ? text.size() : std::min(end + 1, pos + 8);
+            tokens.push_back(text.substr(pos, end - pos));
+            pos = end;
+        }
+        return tokens;
+    }
+
+    bool roll(double rate) {
+        if (rate <= 0) return false;
+        std::lock_guard<std::mutex> lock(rng_mutex);
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+    }
+
+    static size_t contentBytes(const Json::Value& content) {
+        if (content.isString()) return content.asString().size();
+        size_t bytes = 0;
+        if (content.isArray()) {
+            for (const auto& part : content) bytes += part.get("text", "").asString().size();
+        }
+        return bytes;
+    }
+
+    // Prompt caching the way Anthropic does it: the prefix ending at a message
+    // with a cache_control part is stored, and a later request starting with
+    // the same prefix reads it back. Fills an OpenAI-style usage object.
+    Json::Value promptUsage(const Json::Value& messages) {
+        size_t total = 0, cached = 0;
+        std::string prefix;
+        for (const auto& msg : messages) {
+            prefix += compact(msg);
+            total += std::max<size_t>(1, contentBytes(msg["content"]) / 4);
+            bool breakpoint = false;
+            if (msg["content"].isArray()) {
+                for (const auto& part : msg["content"]) breakpoint = breakpoint || part.isMember("cache_control");
+            }
+            if (!breakpoint) continue;
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            if (!cached_prefixes.insert(std::hash<std::string>()(prefix)).second) cached = total;
+        }
+        Json::Value usage;
+        usage["prompt_tokens"] = static_cast<Json::UInt64>(total);
+        usage["prompt_tokens_details"]["cached_tokens"] = static_cast<Json::UInt64>(cached);
+        return usage;
+    }
+
+    static std::string compact(const Json::Value& value) {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return Json::writeString(builder, value);
+    }
+
+    void handle(const httplib::Request& req, httplib::Response& res) {
+        request_count++;
+        // With CPPHTTPLIB_ZLIB_SUPPORT httplib has already inflated the body
+        if (!options.accept_gzip && req.has_header("Content-Encoding")) {
+            res.status = 415;
+            res.set_content("{\"error\":{\"code\":415,\"message\":\"Content-Encoding not supported (mock)\"}}",
+                            "application/json");
+            return;
+        }
+        Json::Value body;
+        Json::CharReaderBuilder reader;
+        std::string errs;
+        std::istringstream in(req.body);
+        if (!Json::parseFromStream(reader, in, &body, &errs) || !body["messages"].isArray()) {
+            res.status = 400;
+            res.set_content("{\"error\":{\"code\":400,\"message\":\"invalid request body\"}}", "application/json");
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.latency_ms));
+
+        if (roll(options.rate_429)) {
+            res.status = 429;
+            res.set_header("Retry-After", std::to_string(options.retry_after_s));
+            res.set_content("{\"error\":{\"code\":429,\"message\":\"Rate limit exceeded (mock)\"}}", "application/json");
+            return;
+        }
+        if (roll(options.rate_5xx)) {
+            res.status = 503;
+            res.set_content("{\"error\":{\"code\":503,\"message\":\"Upstream unavailable (mock)\"}}", "application/json");
+            return;
+        }
+
+        const std::string model = body.get("model", "mock").asString();
+        const std::string text = replyText(body["messages"]);
+        Json::Value usage = promptUsage(body["messages"]);
+        usage["completion_tokens"] = static_cast<Json::UInt64>(tokenize(text).size());
+        if (!body.get("stream", false).asBool()) {
+            Json::Value reply;
+            reply["model"] = model;
+            reply["choices"][0]["message"]["role"] = "assistant";
+            reply["choices"][0]["message"]["content"] = text;
+            reply["usage"] = usage;
+            res.set_content(compact(reply), "application/json");
+            return;
+        }
+
+        auto tokens = std::make_shared<std::vector<std::string>>(tokenize(text));
+        const double pace = options.tokens_per_sec;
+        const bool send_usage = body["stream_options"].get("include_usage", false).asBool();
+        res.set_chunked_content_provider("text/event-stream",
+            [tokens, model, pace, send_usage, usage](size_t, httplib::DataSink& sink) {
+                std::string out = ": OPENROUTER PROCESSING\n\n";
+                sink.write(out.data(), out.size());
+                for (const auto& token : *tokens) {
+                    if (pace > 0) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long>(1e6 / pace)));
+                    }
+                    Json::Value chunk;
+                    chunk["model"] = model;
+                    chunk["choices"][0]["delta"]["content"] = token;
+                    out = "data: " + compact(chunk) + "\n\n";
+                    if (!sink.write(out.data(), out.size())) return false;
+                }
+                if (send_usage) {
+                    Json::Value chunk;
+                    chunk["model"] = model;
+                    chunk["choices"] = Json::Value(Json::arrayValue);
+                    chunk["usage"] = usage;
+                    out = "data: " + compact(chunk) + "\n\n";
+                    sink.write(out.data(), out.size());
+                }
+                out = "data: [DONE]\n\n";
+                sink.write(out.data(), out.size());
+                sink.done();
+                return true;
+            });
+    }
+
+    MockOptions options;
+    httplib::Server server;
+    std::thread thread;
+    std::atomic<unsigned long long> request_count{0};
+    std::mutex rng_mutex;
+    std::mt19937 rng;
+    std::mutex cache_mutex;
+    std::set<size_t> cached_prefixes;
+};
+
+#endif // ORI_MOCK_OPENROUTER_H
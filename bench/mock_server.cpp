@@ -0,0 +1,56 @@
+// Standalone mock of the OpenRouter chat-completions endpoint.
+//
+// Point ori at it with ORI_API_URL (or the api_url config key):
+//   ./ori_mock_server --port 18080 --latency-ms 300 --tps 40 --rate-429 0.1 &
+//   ORI_API_URL=http://127.0.0.1:18080/api/v1/chat/completions OPENROUTER_API_KEY=x ori
+//
+// Usage: ori_mock_server [--port N] [--latency-ms N] [--tps N] [--tokens N]
+//                        [--rate-429 F] [--rate-5xx F] [--retry-after S]
+//                        [--reply text|exec|execs|edit] [--no-gzip] [--unix-socket PATH]
+
+#include "mock_openrouter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+int main(int argc, char* argv[]) {
+    MockOptions options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--no-gzip") {
+            options.accept_gzip = false;
+            i--;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", flag.c_str());
+            return 1;
+        }
+        const char* value = argv[i + 1];
+        if (flag == "--port") options.port = std::atoi(value);
+        else if (flag == "--latency-ms") options.latency_ms = std::atoi(value);
+        else if (flag == "--tps") options.tokens_per_sec = std::atof(value);
+        else if (flag == "--tokens") options.reply_tokens = std::strtoul(value, nullptr, 10);
+        else if (flag == "--rate-429") options.rate_429 = std::atof(value);
+        else if (flag == "--rate-5xx") options.rate_5xx = std::atof(value);
+        else if (flag == "--retry-after") options.retry_after_s = std::atoi(value);
+        else if (flag == "--reply") options.reply = value;
+        else if (flag == "--unix-socket") options.unix_socket = value;
+        else {
+            std::fprintf(stderr, "Unknown option: %s\n", flag.c_str());
+            return 1;
+        }
+    }
+
+    MockOpenRouter mock(options);
+    if (!mock.start()) {
+        std::fprintf(stderr, "Could not listen on %s:%d\n", options.host.c_str(), options.port);
+        return 1;
+    }
+    std::printf("Mock OpenRouter listening at %s\n", mock.url().c_str());
+    std::fflush(stdout);
+    while (true) {
+        pause();
+    }
+}
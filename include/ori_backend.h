@@ -0,0 +1,46 @@
+#ifndef ORI_BACKEND_H
+#define ORI_BACKEND_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <json/json.h>
+
+// One OpenAI-compatible chat-completions server and how to talk to it. The
+// built-in profile is OpenRouter; config.json can describe others (a local
+// llama.cpp, vLLM or Ollama server) under "backends" and pick one with
+// "backend". A profile with a unix_socket, or an http:// loopback URL, skips
+// TLS entirely.
+struct BackendProfile {
+    std::string name;
+    std::string base_url;         // ".../v1", or a full ".../chat/completions" URL
+    std::string auth = "bearer";  // "bearer", "none" or "header:<Name>"
+    std::string api_key;          // literal key for this server
+    std::string api_key_env;      // or the environment variable holding it
+    std::map<std::string, std::string> headers; // extra request headers
+    std::map<std::string, std::string> models;  // Ori model name -> server model name; "*" maps the rest
+    std::string unix_socket;      // connect to this socket instead of the URL's host
+
+    static BackendProfile openRouter();
+    static BackendProfile fromJson(const std::string& name, const Json::Value& value);
+    Json::Value toJson() const;
+
+    bool isOpenRouter() const { return name == "openrouter"; }
+    bool needsKey() const { return auth != "none"; }
+    // URL requests are POSTed to
+    std::string chatUrl() const;
+    // The key from api_key or api_key_env; empty if neither gives one
+    std::string configuredKey() const;
+    // Model name to put in the request body
+    std::string mapModel(const std::string& model) const;
+    // Authentication header for `key` (none for auth "none") plus the extra headers
+    std::vector<std::string> requestHeaders(const std::string& key) const;
+};
+
+// Pick the profile named `name` ("" or "openrouter" is the built-in one, whose
+// URL api_url replaces when set). Returns false with `error` set when no
+// profile has that name or the profile is unusable.
+bool resolveBackend(const std::string& name, const std::map<std::string, BackendProfile>& profiles,
+                    const std::string& api_url, BackendProfile& out, std::string& error);
+
+#endif // ORI_BACKEND_H
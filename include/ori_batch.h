@@ -0,0 +1,23 @@
+#ifndef ORI_BATCH_H
+#define ORI_BATCH_H
+
+#include <string>
+#include "ori_core.h"
+
+struct BatchOptions {
+    std::string input_path;  // JSONL: {"id", "prompt", "model", "system"} per line
+    std::string output_path; // JSONL results; also the checkpoint for resuming
+    int concurrency = 4;     // requests in flight at once
+    int max_attempts = 3;    // tries per item; each try already retries 429/5xx itself
+};
+
+// Run every prompt of a JSONL file through the API in one process, with at
+// most `concurrency` requests in flight on the shared network loop. Each item
+// is an independent one-turn conversation; replies are recorded, never acted
+// on ([exec] blocks are not run). A result line is appended to the output as
+// soon as its item settles, so an interrupted run resumes by skipping the ids
+// that already have an "ok": true line. Returns the process exit status.
+int runBatch(const BatchOptions& options, const Config& config, const BackendProfile& backend,
+             const std::string& api_key, const std::string& default_system_prompt);
+
+#endif // ORI_BATCH_H
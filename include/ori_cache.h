@@ -0,0 +1,90 @@
+#ifndef ORI_CACHE_H
+#define ORI_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include "ori_protocol.h"
+
+// Opt-in cache of completed replies, keyed by a digest of the exact request
+// (model, serialized messages and generation parameters). It has a bounded
+// in-memory LRU tier and an on-disk tier with a TTL, and it is process-wide
+// so the GUI's worker threads share it. Identical requests that arrive while
+// one is already in flight are answered from that one instead of calling the
+// API again; they register a callback rather than block, so a caller that
+// starts many requests from one thread (batch mode) keeps going.
+class ResponseCache {
+public:
+    struct Stats {
+        unsigned long long memory_hits;
+        unsigned long long disk_hits;
+        unsigned long long shared_flights; // requests served by another in-flight request
+        unsigned long long misses;
+    };
+
+    static ResponseCache& instance();
+
+    // dir is where the disk tier lives; an empty dir keeps the cache in memory only.
+    void configure(bool enabled, long ttl_seconds, size_t max_memory_entries, const std::string& dir);
+    bool enabled() const { return is_enabled; }
+
+    // Digest of every byte in `body` (not cryptographic; 128 bits of FNV-1a).
+    static std::string keyFor(const RequestBody& body);
+
+    enum class Lookup {
+        Hit,    // `reply` is filled from the cache
+        Miss,   // the caller is now the one request for `key` and must report back with complete()
+        Joined, // an identical request is in flight; `waiter` will get its outcome
+    };
+    // Called from complete(), on the thread that finished the request. With
+    // ok false that request failed, and the waiter should acquire() again.
+    using Waiter = std::function<void(bool ok, const std::string& reply)>;
+
+    // Never blocks on another request.
+    Lookup acquire(const std::string& key, std::string& reply, Waiter waiter);
+    // Finish a request started after acquire() returned Miss. Successful
+    // replies are stored; either way the waiters on `key` are called.
+    void complete(const std::string& key, bool ok, const std::string& reply);
+
+    Stats stats() const;
+
+private:
+    ResponseCache() = default;
+
+    struct Entry {
+        std::string key;
+        std::string reply;
+        long long created; // unix seconds
+    };
+    struct Flight {
+        std::vector<Waiter> waiters;
+    };
+
+    bool lookupMemoryLocked(const std::string& key, std::string& reply);
+    void rememberLocked(const std::string& key, const std::string& reply, long long created);
+    // Called without the lock; path is diskPath(key), or empty without a disk tier
+    static bool readDisk(const std::string& path, long ttl_s, std::string& reply, long long& created);
+    static void writeDisk(const std::string& path, const std::string& reply, long long created);
+    std::string diskPath(const std::string& key) const;
+
+    mutable std::mutex mutex;
+    bool is_enabled = false;
+    long ttl = 86400;
+    size_t max_entries = 256;
+    std::string cache_dir;
+    std::list<Entry> lru; // most recently used at the front
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> in_flight;
+
+    std::atomic<unsigned long long> memory_hits{0};
+    std::atomic<unsigned long long> disk_hits{0};
+    std::atomic<unsigned long long> shared_flights{0};
+    std::atomic<unsigned long long> misses{0};
+};
+
+#endif // ORI_CACHE_H
@@ -0,0 +1,71 @@
+#ifndef ORI_CONTEXT_H
+#define ORI_CONTEXT_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "ori_protocol.h"
+
+// How much of the conversation may be sent with each request.
+struct ContextPolicy {
+    size_t budget_tokens = 0; // prompt budget for the current model; 0 = unlimited
+    size_t keep_recent = 6;   // newest messages that are never elided or dropped
+    bool compact = true;      // summarize older turns in the background
+};
+
+// Rough token count: about 3.5 bytes per token plus per-message framing.
+// Good enough to stay under a limit without shipping a tokenizer.
+size_t estimateTokens(const ChatMessage& msg);
+size_t estimateTokens(const std::vector<ChatMessage>& history);
+
+// Keeps conversation_history inside the model's context window. The system
+// prompt (index 0) and the newest policy.keep_recent messages are never
+// touched. Over budget, old tool outputs are elided first, then the oldest
+// turns are dropped. Past COMPACT_THRESHOLD of the budget, older turns are
+// summarized on a background thread and swapped in on a later turn, so the
+// user never waits for the summary.
+class ContextManager {
+public:
+    // Fraction of the budget at which background compaction starts.
+    static constexpr double COMPACT_THRESHOLD = 0.75;
+
+    // Turns a transcript into a summary; runs on the worker thread. Should
+    // give up early and return "" once `cancelled` becomes true.
+    using Summarizer = std::function<std::string(const std::string& transcript, const std::atomic<bool>& cancelled)>;
+
+    ContextManager() = default;
+    ~ContextManager();
+    ContextManager(const ContextManager&) = delete;
+    ContextManager& operator=(const ContextManager&) = delete;
+
+    // Each of these returns the index of the first message it changed, or
+    // history.size() if nothing changed, so cached JSON can be invalidated.
+    size_t applyCompaction(std::vector<ChatMessage>& history);
+    size_t enforce(std::vector<ChatMessage>& history, const ContextPolicy& policy);
+
+    void maybeStartCompaction(const std::vector<ChatMessage>& history, const ContextPolicy& policy, Summarizer summarize);
+
+    // The caller rewrote the history (e.g. a new system prompt); any summary
+    // still in flight no longer matches and will be discarded.
+    void historyRewritten();
+
+private:
+    void bumpGeneration();
+
+    std::mutex mutex;
+    std::thread worker;
+    std::atomic<bool> cancelled{false};
+    bool running = false;
+    unsigned long generation = 0;
+
+    // Result of the last finished compaction
+    bool summary_ready = false;
+    std::string summary;
+    size_t summary_covers = 0;        // messages 1..summary_covers were summarized
+    unsigned long summary_generation = 0;
+};
+
+#endif // ORI_CONTEXT_H
@@ -5,15 +5,18 @@
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <functional>
+#include <map>
 
 #ifdef CURL_FOUND
 #include <curl/curl.h>
 #endif
 
-struct ChatMessage {
-    std::string role;
-    std::string content;
-};
+#include "ori_protocol.h"
+#include "ori_context.h"
+#include "ori_update.h"
+#include "ori_backend.h"
+#include "ori_exec.h"
 
 struct Config {
     int port;
@@ -21,6 +24,32 @@ struct Config {
     bool no_clear;
     std::string model;
     bool debug; // Added debug flag
+    bool prewarm; // Open the API connection in the background while the user types
+    bool stream; // Print the reply token by token as it arrives
+    int context_budget; // Prompt token budget for models without an entry below (0 = unlimited)
+    std::map<std::string, int> context_budgets; // Per-model prompt token budgets
+    int context_keep_recent; // Newest messages that are always sent intact
+    bool context_compact; // Summarize older turns in the background
+    bool cache; // Reuse replies to identical requests (opt-in)
+    int cache_ttl; // Seconds a cached reply stays valid
+    int cache_entries; // Replies kept in the in-memory tier
+    std::string hedge_models; // Comma-separated fallback models raced against a slow primary
+    int hedge_delay_ms; // How long a model may stay silent before the next one is tried
+    std::string api_url; // Chat-completions endpoint; empty = OpenRouter (ORI_API_URL overrides)
+    bool compress_requests; // Gzip large request bodies (falls back if the endpoint refuses)
+    bool prompt_cache; // Mark the system prompt and /cat'd files as cacheable for models that need hints
+    std::string backend; // Name of the server profile to use; empty = OpenRouter
+    std::map<std::string, BackendProfile> backends; // Server profiles by name
+    int exec_parallelism; // Commands from one reply that may run at the same time
+    int exec_output_bytes; // Command output kept for the model, head and tail (0 = all)
+    int exec_output_lines; // Lines of command output sent to the model, head and tail (0 = all)
+    int exec_log_retention; // Seconds the GUI keeps a finished command's log, and a killed session's output files last
+    int exec_timeout; // Wall-clock seconds a command may run (0 = no limit)
+    int exec_cpu_seconds; // CPU seconds a command may use (0 = no limit)
+    int exec_memory_mb; // Memory a command may use, in MB (0 = no limit)
+    int exec_max_output; // Bytes of output after which a command is stopped (0 = no limit)
+    int exec_max_processes; // Processes a command may run at once (0 = no limit)
+    bool exec_persistent_shell; // Run [exec] and /exec commands in one long-lived shell that keeps cd and variables
 
     Config();
 };
@@ -48,16 +77,40 @@ public:
     std::string getAllConfig();
 };
 
+// The exec_* limits of a config, for ExecOptions and the GUI's jobs
+ExecLimits execLimitsFrom(const Config& config);
+
 class OpenRouterAPI {
 private:
     std::string api_key;
+    BackendProfile backend;
+    std::string api_url; // backend.chatUrl(), or ORI_API_URL
     std::string model;
     std::vector<ChatMessage> conversation_history;
+    // Cached JSON for conversation_history; invalidate it when rewriting history
+    HistorySerializer history_serializer;
+    ContextManager context_manager;
+    ContextPolicy context_policy;
+    std::map<std::string, int> context_budgets;
+    int default_context_budget = 0;
+    std::vector<std::string> hedge_models;
+    long hedge_delay_ms = 4000;
+    bool compress_requests = false;
+    bool prompt_cache = true;
+    ContextPolicy currentContextPolicy() const;
+    // Single non-streaming request with no history, retries or spinner. Used
+    // from background threads; gives up once `cancelled` becomes true.
+    static std::string completeOnce(const BackendProfile& backend, const std::string& url, const std::string& key,
+                                    const std::string& model_name,
+                                    const std::string& system_prompt, const std::string& user_prompt,
+                                    const std::atomic<bool>& cancelled);
     std::string getMotherboardFingerprint();
     bool m_isGui = false;
     std::string colorize(const std::string& color, const std::string& text);
     
 public:
+    using TokenCallback = std::function<void(const std::string&)>;
+
     OpenRouterAPI();
     ~OpenRouterAPI();
     
@@ -65,15 +118,67 @@ public:
     bool setApiKey(const std::string& key);
     std::string getApiKey() const;
     void setModel(const std::string& model_name);
+    // Server to send requests to (see resolveBackend); ORI_API_URL, if set, still wins for the URL
+    void setBackend(const BackendProfile& profile);
+    const BackendProfile& getBackend() const { return backend; }
+    // Gzip request bodies above a few KB; endpoints answering 415 get plain ones
+    void setCompressRequests(bool enabled);
     void setIsGui(bool isGui);
     void setSystemPrompt(const std::string& prompt);
+    // Take the context budget, per-model budgets, compaction and prompt cache settings from config
+    void setContextConfig(const Config& config);
+    // Take the fallback models and delay for hedged requests from config
+    void setHedgeConfig(const Config& config);
+    // Queue text (a /cat'd file, /exec output) to go out with the next request.
+    // pinned text is meant to stay for the rest of the conversation and ends
+    // a cacheable prefix, while breakpoints are left (see MAX_CACHE_BREAKPOINTS).
+    void addContext(const std::string& text, bool pinned = false);
+    // Start connecting to the API endpoint in the background (no-op if recently used)
+    void prewarmConnection();
     
-    std::string sendQuery(const std::string& prompt);
+    // Send a user turn and return the assistant reply. When on_token is set the
+    // request is streamed and each text delta is passed to it as it arrives;
+    // the full reply is still returned and recorded in the history. on_token
+    // runs on the calling thread, so it may block (write to a socket or terminal).
+    // tool_output marks prompts that carry command output, which are the
+    // first thing elided when the conversation outgrows its context budget.
+    std::string sendQuery(const std::string& prompt, const TokenCallback& on_token = nullptr, bool tool_output = false);
+
+    // Outcome of the most recent query, valid once its reply is delivered
+    struct QueryStats {
+        bool ok = false;      // false when the reply is an error message
+        std::string error;    // plain-text error when !ok
+        std::string model;    // model whose reply was used (differs when a hedge won)
+        int retries = 0;      // request retries after 429/5xx/transport errors
+        bool cached = false;
+        Json::Value usage;    // the provider's token counts; null if none were sent
+        long long prompt_tokens = -1; // from usage; -1 if it had none
+        long long cached_prompt_tokens = 0; // of those, served from the provider's prefix cache
+    };
+    const QueryStats& lastQueryStats() const { return last_stats; }
+
+    using DoneCallback = std::function<void(const std::string& reply)>;
+    using StatusCallback = std::function<void(const std::string& message)>;
+    // Non-blocking sendQuery. The transfer runs on the shared network thread,
+    // which also calls on_token, on_status (retry notices) and finally on_done
+    // with the reply or error text; a cached reply is delivered before this
+    // returns. A conversation is sequential: wait for on_done before the next
+    // call on the same OpenRouterAPI. Every transfer in the process shares
+    // that thread, so callbacks must not block: no socket or terminal writes,
+    // no joins. Queue the work to your own thread, as sendQuery does.
+    void sendQueryAsync(const std::string& prompt, TokenCallback on_token, DoneCallback on_done,
+                        bool tool_output = false, StatusCallback on_status = nullptr);
+
+private:
+    QueryStats last_stats;
 };
 
 struct CommandLogEntry {
     std::string command;
     std::string output;
+    double seconds = 0;
+    ResourceUsage usage;
+    std::string limit; // "the 30 s time limit" when one stopped the command
 };
 
 class OriAssistant {
@@ -83,9 +188,17 @@ private:
     size_t current_output_lines = 0;  // Track number of lines output
     std::vector<CommandLogEntry> command_log;
     bool show_command_log = false;
+    ShellSession shell_session; // used when config.exec_persistent_shell is set
+    // Run commands for [exec] and /exec: one after another in shell_session
+    // when config.exec_persistent_shell is set, else with runCommands
+    std::vector<CommandResult> runAssistantCommands(const std::vector<std::string>& commands, const ExecOptions& options);
     void displayCommandLog();
     void showBanner();
     std::string pre_prompt_context;
+    std::string pinned_context; // /cat'd files, sent as one cacheable message
+    UpdateChecker update_checker;
+    // Print a pending "new version" notice; raw terminal mode needs "\r\n"
+    void showUpdateNotice(const char* newline = "\n");
 
 public:
     std::unique_ptr<OpenRouterAPI> api;
@@ -99,15 +212,24 @@ public:
     ~OriAssistant();
     
     void setExecutablePath(const std::string& path);
-    bool initialize();
+    // Load the config and the API key. adjust_config, if set, edits the
+    // loaded config (command-line overrides) before anything reads it.
+    bool initialize(const std::function<void(Config&)>& adjust_config = nullptr);
     void run();
     void showHelp();
     // Read a line (possibly multiline) from the user with basic editing support.
     // Supports Alt+Enter to insert a newline without submitting.
     std::string readInput();
-    void processSingleRequest(const std::string& prompt, bool auto_confirm);
+    void processSingleRequest(const std::string& prompt, bool auto_confirm, bool tool_output = false);
     void handleCommandExecution(const std::string& command, bool auto_confirm, bool send_to_ai = true);
-    void handleResponse(const std::string& response, bool auto_confirm);
+    // Several [exec] blocks from one reply: confirm them together, run up to
+    // config.exec_parallelism at once and send all the output back in one message.
+    void handleCommandBatch(const std::vector<std::string>& commands, bool auto_confirm);
+    // Act on [exec]/[edit]/[writefile] blocks in a reply. With text_streamed the
+    // plain text was already printed while streaming and is not echoed again.
+    void handleResponse(const std::string& response, bool auto_confirm, bool text_streamed = false);
+    // silent: start a background check whose notice shows up at the prompt.
+    // Otherwise fetch now and offer to install a newer release.
     void checkForUpdates(bool silent);
 };
 
@@ -0,0 +1,141 @@
+#ifndef ORI_EXEC_H
+#define ORI_EXEC_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <sys/types.h>
+#include "ori_output.h"
+
+// Running shell commands for [exec] and /exec. Each command is `/bin/sh -c`
+// in its own process group with stdout and stderr on one pipe. One poll()
+// loop waits on every pipe plus a pidfd per child (Linux 5.3+; without one it
+// falls back to a short timeout and waitpid), so nothing spins while a
+// command is quiet and output is read in 64 KB slices as soon as it arrives.
+
+// Caps on one command; 0 leaves a limit off. Memory and process limits use a
+// cgroup v2 sub-group when the cgroup Ori runs in hands the memory and pids
+// controllers down to it, and RLIMIT_AS / RLIMIT_NPROC otherwise (per
+// process, and for NPROC counted in threads on top of all the user already
+// runs, Ori's own threads included).
+struct ExecLimits {
+    int timeout_s = 0;                  // wall clock
+    int cpu_s = 0;                      // CPU seconds, RLIMIT_CPU
+    long long memory_mb = 0;
+    unsigned long long max_output = 0;  // bytes of output before the command is stopped
+    int max_processes = 0;
+
+    bool any() const { return timeout_s > 0 || cpu_s > 0 || memory_mb > 0 || max_output > 0 || max_processes > 0; }
+};
+
+// What a finished command used: the shell plus every descendant it waited
+// for, from wait4(); peak memory from the cgroup when there is one
+struct ResourceUsage {
+    bool valid = false;
+    double user_s = 0;
+    double system_s = 0;
+    long long peak_rss_kb = 0;
+    long long read_bytes = 0;    // block I/O
+    long long written_bytes = 0;
+
+    // "cpu 0.12s (0.10 user), peak 12.3 MB, I/O 0 B in / 4.0 KB out"
+    std::string summary() const;
+};
+
+// A started command
+struct ChildProcess {
+    pid_t pid = -1;
+    int out_fd = -1;  // stdout and stderr, nonblocking
+    int pid_fd = -1;  // readable once the child has exited; -1 without pidfd support
+    int in_fd = -1;   // the child's stdin (a socket, see send_stdin), or -1 when it shares ours
+    std::string cgroup; // sub-group directory, when limits put it in one
+};
+
+// Fork `/bin/sh -c command` in a new process group, under `limits`. False if
+// the pipe or the fork failed. With send_stdin the child reads its stdin from
+// child.in_fd, a socket so that writing to a dead child fails with EPIPE
+// (send with MSG_NOSIGNAL) instead of raising SIGPIPE.
+bool spawnCommand(const std::string& command, ChildProcess& child, const ExecLimits& limits = ExecLimits(),
+                  bool send_stdin = false);
+
+// Whether the child has exited, without reaping it (so its pid stays taken)
+bool childExited(const ChildProcess& child);
+
+// Signal the child's process group, and with SIGKILL every process in its cgroup
+void signalChild(const ChildProcess& child, int sig);
+
+// Collect an exited child: its status and usage, and which limit stopped it
+// if one did (see CommandResult::limit). Closes the pidfd and removes the cgroup.
+void reapChild(ChildProcess& child, const ExecLimits& limits, int& status, ResourceUsage& usage, std::string& limit);
+
+// "the 30 s time limit" for a CommandResult::limit value
+std::string describeLimit(const std::string& limit, const ExecLimits& limits);
+
+struct CommandResult {
+    OutputCapture output;
+    bool started = false;
+    bool cancelled = false;  // killed, or never started, because `cancel` was set
+    int status = 0;          // from waitpid
+    double seconds = 0;
+    ResourceUsage usage;
+    std::string limit;       // "timeout", "output", "cpu" or "memory" when one stopped the command
+};
+
+struct ExecOptions {
+    size_t parallelism = 1;
+    ExecLimits limits;
+    // Output each command keeps in memory (see OutputCapture); 0 = all of it
+    size_t max_output_bytes = 0;
+    // on_output sees new output at most this often (the spinner's 12 fps)
+    int flush_interval_ms = 83;
+    // Output of command `index` since the previous call
+    std::function<void(size_t index, const std::string& chunk)> on_output;
+    // Command `index` exited or failed to start; its last output was flushed first
+    std::function<void(size_t index, const CommandResult& result)> on_exit;
+    // Checked between events; once true every running process group is
+    // killed and the commands still queued are not started
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+// Run the commands, at most options.parallelism at a time, and return their
+// results in the same order once all of them are done.
+std::vector<CommandResult> runCommands(const std::vector<std::string>& commands, const ExecOptions& options);
+
+// One long-lived shell (bash when there is one, else sh) that runs commands
+// one after another, so cd, exported variables and activated virtualenvs
+// carry over from one command to the next. Each command is written to the
+// shell's stdin as `eval '<command>' </dev/null` followed by a printf of a
+// per-session random marker, the exit status and $PWD on a line of their
+// own; output up to that line is the command's. printf assembles the marker
+// from two arguments, so a shell echoing its input (`set -v`) cannot fake
+// it. If the shell dies (`exit`, a limit, Ctrl-C) the next command starts a
+// new one in the last directory it reported; its variables are lost, and the
+// output says so. A shell left idle with its stdout redirected away (`exec
+// >/dev/null`) would never print the marker, so it is stopped the same way.
+class ShellSession {
+public:
+    ShellSession() = default;
+    ~ShellSession();
+    ShellSession(const ShellSession&) = delete;
+    ShellSession& operator=(const ShellSession&) = delete;
+
+    // Run `command`, starting the shell first if needed (or again, when
+    // options.limits changed). Callbacks get index 0; parallelism is ignored.
+    // Usage covers CPU time only, as the shell is not reaped in between.
+    CommandResult run(const std::string& command, const ExecOptions& options);
+    // Kill the shell; the next run() starts a fresh one
+    void stop();
+    bool running() const { return shell.pid > 0; }
+
+private:
+    bool start(const ExecLimits& new_limits);
+
+    ChildProcess shell;
+    ExecLimits limits;         // the running shell's
+    std::string marker_token;  // random, per session
+    std::string marker;        // "__ori_done_" + marker_token; starts the line ending each command's output
+    std::string cwd;           // last directory the shell reported
+};
+
+#endif // ORI_EXEC_H
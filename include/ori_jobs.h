@@ -0,0 +1,96 @@
+#ifndef ORI_JOBS_H
+#define ORI_JOBS_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <sys/types.h>
+#include <json/json.h>
+#include "ori_exec.h"
+
+// Commands started from the GUI (/api/exec) that outlive the request. One
+// supervisor thread polls every job's output pipe and pidfd: it appends
+// output to the job's log file, reaps the child as soon as it exits and
+// records how it ended. Logs of finished jobs are deleted after the
+// retention period, oldest first once more than MAX_FINISHED are kept.
+class CommandJobs {
+public:
+    static constexpr size_t MAX_FINISHED = 100;
+    // A killed job gets SIGTERM, then SIGKILL if it is still there after this
+    static constexpr int KILL_GRACE_MS = 2000;
+
+    static CommandJobs& instance();
+    ~CommandJobs();
+
+    // Seconds a finished job's log is kept
+    void setRetention(int seconds);
+    // Limits for jobs started from now on
+    void setLimits(const ExecLimits& limits);
+
+    // Start `command`; false with `error` set if it could not be spawned
+    bool start(const std::string& command, std::string& id, std::string& error);
+
+    // Log bytes from `offset` (at most max_bytes, never ending inside a UTF-8
+    // sequence while more may follow) plus the job's state. False for an
+    // unknown or expired id.
+    bool read(const std::string& id, size_t offset, size_t max_bytes, std::string& data, Json::Value& state);
+
+    // Block until one of the jobs' logs has grown past its seen size (id ->
+    // bytes) or one of them has ended or expired, or for at most `timeout`.
+    // False if none of the ids is known. Viewers wait here on the
+    // supervisor's one reader instead of each polling the logs.
+    bool waitForOutput(const std::map<std::string, size_t>& seen, std::chrono::milliseconds timeout);
+
+    // Stop the job's whole process group; false for an unknown or finished job
+    bool kill(const std::string& id);
+
+    // Lock-free, for the /metrics gauge: it must not wait behind start() or the supervisor
+    long long runningCount() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::string command;
+        std::string log_path;
+        ChildProcess child;
+        ExecLimits limits;
+        int log_fd = -1;
+        size_t log_bytes = 0;
+        bool running = true;
+        bool killed = false;
+        int status = 0;
+        Clock::time_point started;
+        Clock::time_point finished;
+        Clock::time_point kill_deadline; // SIGKILL due, once killed
+        Clock::time_point deadline; // for limits.timeout_s
+        double seconds = 0;
+        ResourceUsage usage;
+        std::string limit; // see CommandResult::limit
+    };
+
+    CommandJobs() = default;
+    void supervise();
+    void finishJob(Job& job); // with the lock held
+    void sweep(); // with the lock held
+    void wake();
+    Json::Value stateOf(const Job& job) const;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed; // a log grew or a job ended
+    std::map<std::string, std::shared_ptr<Job>> jobs;
+    long long next_id = 0;
+    std::atomic<long long> running{0}; // changed with the lock held, read without it
+    int retention_s = 3600;
+    ExecLimits limits;
+    int wake_fd[2] = {-1, -1};
+    bool stopping = false;
+    std::thread supervisor;
+};
+
+#endif // ORI_JOBS_H
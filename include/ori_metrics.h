@@ -0,0 +1,106 @@
+#ifndef ORI_METRICS_H
+#define ORI_METRICS_H
+
+#include <string>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+// Lock-free building blocks for the Prometheus /metrics endpoint. Updates are
+// relaxed atomic adds and a lookup never takes a lock, so recording costs the
+// request path a few instructions and a scrape never stalls it.
+
+// Cumulative histogram with fixed buckets, in seconds
+class LatencyHistogram {
+public:
+    static const size_t BUCKETS = 14;
+
+    void observe(double seconds);
+    // Append the _bucket, _sum and _count series of `name`; labels is
+    // `key="value",...` or empty
+    void render(std::string& out, const std::string& name, const std::string& labels) const;
+
+private:
+    std::atomic<unsigned long long> counts[BUCKETS + 1] = {};
+    std::atomic<unsigned long long> total{0};
+    std::atomic<unsigned long long> sum_us{0};
+};
+
+// Fixed-capacity map from a label value to its metrics. Entries are added
+// with one compare-and-swap and never removed; once the table is full, new
+// labels share the "other" entry.
+template <typename T, size_t CAPACITY = 64>
+class MetricFamily {
+public:
+    MetricFamily() : other("other") {
+        for (auto& slot : slots) slot.store(nullptr, std::memory_order_relaxed);
+    }
+    ~MetricFamily() {
+        for (auto& slot : slots) delete slot.load();
+    }
+    MetricFamily(const MetricFamily&) = delete;
+    MetricFamily& operator=(const MetricFamily&) = delete;
+
+    T& get(const std::string& label) {
+        size_t start = std::hash<std::string>()(label) % CAPACITY;
+        for (size_t probe = 0; probe < CAPACITY; ++probe) {
+            std::atomic<Entry*>& slot = slots[(start + probe) % CAPACITY];
+            Entry* entry = slot.load(std::memory_order_acquire);
+            if (!entry) {
+                Entry* created = new Entry(label);
+                if (slot.compare_exchange_strong(entry, created, std::memory_order_acq_rel)) return created->value;
+                delete created; // another thread filled the slot; entry now holds its value
+            }
+            if (entry->label == label) return entry->value;
+        }
+        return other.value;
+    }
+
+    // f(label, const T&) for every entry, "other" last if it was used
+    template <typename F>
+    void forEach(F f) const {
+        for (const auto& slot : slots) {
+            const Entry* entry = slot.load(std::memory_order_acquire);
+            if (entry) f(entry->label, entry->value);
+        }
+        if (other.used()) f(other.label, other.value);
+    }
+
+private:
+    struct Entry {
+        explicit Entry(std::string label) : label(std::move(label)) {}
+        bool used() const { return value.used(); }
+        const std::string label;
+        T value;
+    };
+    std::atomic<Entry*> slots[CAPACITY];
+    Entry other;
+};
+
+// Chat transfers to one model
+struct UpstreamMetrics {
+    std::atomic<unsigned long long> ok{0};
+    std::atomic<unsigned long long> http_errors{0};
+    std::atomic<unsigned long long> transport_errors{0};
+    std::atomic<unsigned long long> cancelled{0}; // lost a hedge race
+    std::atomic<unsigned long long> retries{0};
+    std::atomic<unsigned long long> prompt_tokens{0};
+    std::atomic<unsigned long long> cached_tokens{0};
+    std::atomic<unsigned long long> completion_tokens{0};
+    LatencyHistogram duration;
+    LatencyHistogram first_byte;
+    bool used() const { return ok + http_errors + transport_errors + cancelled > 0; }
+};
+
+MetricFamily<UpstreamMetrics>& upstreamMetrics();
+
+// `value` escaped for use inside a quoted label
+std::string metricLabel(const std::string& value);
+
+// Append "# HELP" and "# TYPE" lines
+void metricHeader(std::string& out, const char* name, const char* type, const char* help);
+
+// Append the upstream, transfer and prompt cache series of this process
+void renderProcessMetrics(std::string& out);
+
+#endif // ORI_METRICS_H
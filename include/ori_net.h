@@ -0,0 +1,143 @@
+#ifndef ORI_NET_H
+#define ORI_NET_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+
+#ifdef CURL_FOUND
+#include <curl/curl.h>
+#endif
+#include <json/json.h>
+#include "ori_protocol.h"
+
+// Process-wide pool of libcurl easy handles. Every handle is attached to one
+// CURLSH so the DNS cache, TLS sessions and live connections survive between
+// turns and between OpenRouterAPI instances (the GUI creates one per request).
+class ConnectionPool {
+public:
+    static ConnectionPool& instance();
+
+#ifdef CURL_FOUND
+    // Hand out a ready-to-configure easy handle. Callers must give it back
+    // with release() instead of curl_easy_cleanup() so the connection stays warm.
+    CURL* acquire();
+    void release(CURL* handle);
+#endif
+
+    // Open a connection to `url` (through `unix_socket` when set) on a
+    // background thread so the next request skips DNS, TCP and TLS. Does
+    // nothing if the pool was used recently.
+    void prewarm(const std::string& url, const std::string& unix_socket = "");
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+private:
+    ConnectionPool();
+    ~ConnectionPool();
+
+    void touch();
+
+#ifdef CURL_FOUND
+    static void lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockShare(CURL* handle, curl_lock_data data, void* userptr);
+
+    CURLSH* share = nullptr;
+    std::mutex share_locks[CURL_LOCK_DATA_LAST];
+    std::vector<CURL*> idle_handles;
+#endif
+    std::mutex pool_mutex;
+    std::atomic<bool> prewarm_running{false};
+    std::atomic<long long> last_used_ms{0};
+};
+
+// Chat traffic in bytes, process-wide: "logical" is the JSON as built or as
+// handed to us after decoding, "wire" is what crossed the network after
+// Content-Encoding, so the two show what compression saves.
+class TransferCounters {
+public:
+    static TransferCounters& instance();
+
+    void addUpload(unsigned long long logical, unsigned long long wire);
+    void addDownload(unsigned long long logical, unsigned long long wire);
+    Json::Value snapshot() const;
+
+private:
+    TransferCounters() = default;
+
+    std::atomic<unsigned long long> uploads{0};
+    std::atomic<unsigned long long> upload_logical{0};
+    std::atomic<unsigned long long> upload_wire{0};
+    std::atomic<unsigned long long> downloads{0};
+    std::atomic<unsigned long long> download_logical{0};
+    std::atomic<unsigned long long> download_wire{0};
+};
+
+// Prompt tokens sent and how many the providers served from their prefix
+// cache, process-wide, for replies that reported usage.
+class PromptCacheCounters {
+public:
+    static PromptCacheCounters& instance();
+
+    void add(long long prompt_tokens, long long cached_tokens);
+    Json::Value snapshot() const;
+
+private:
+    PromptCacheCounters() = default;
+
+    std::atomic<unsigned long long> replies{0};
+    std::atomic<unsigned long long> replies_with_hits{0};
+    std::atomic<unsigned long long> prompt_tokens{0};
+    std::atomic<unsigned long long> cached_tokens{0};
+};
+
+// Gzip `body` into `out`, for a request sent with "Content-Encoding: gzip".
+// Returns false (leaving `out` untouched) when built without zlib.
+bool gzipRequestBody(const RequestBody& body, RequestBody& out);
+
+#ifdef CURL_FOUND
+// One background thread running a curl_multi loop. Transfers from every
+// conversation are driven here, so concurrent requests share one thread
+// instead of each blocking a thread of its own. Transfer callbacks, done
+// callbacks and posted tasks all run on this thread, one at a time.
+class NetworkLoop {
+public:
+    using Task = std::function<void()>;
+    using DoneCallback = std::function<void(CURLcode result)>;
+
+    static NetworkLoop& instance();
+
+    // Run `task` on the loop thread, after `delay_ms` if non-zero. Thread-safe.
+    void post(Task task, long delay_ms = 0);
+
+    // Loop thread only. Start a fully configured transfer; on_done runs once
+    // it ends. The caller keeps ownership of the handle.
+    void start(CURL* handle, DoneCallback on_done);
+    // Loop thread only. Stop a running transfer; its on_done is not called.
+    void abort(CURL* handle);
+
+    NetworkLoop(const NetworkLoop&) = delete;
+    NetworkLoop& operator=(const NetworkLoop&) = delete;
+
+private:
+    NetworkLoop();
+    ~NetworkLoop();
+
+    void run();
+
+    CURLM* multi = nullptr;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::mutex task_mutex;
+    std::multimap<std::chrono::steady_clock::time_point, Task> tasks; // ordered by due time
+    std::map<CURL*, DoneCallback> active; // loop thread only
+};
+#endif
+
+#endif // ORI_NET_H
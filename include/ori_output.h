@@ -0,0 +1,59 @@
+#ifndef ORI_OUTPUT_H
+#define ORI_OUTPUT_H
+
+#include <string>
+#include <memory>
+#include <cstdio>
+
+// Command output as it is kept for the model. Up to max_bytes stay in memory:
+// the first half as it came, the rest as a rolling tail. Once a command
+// writes more than that, everything from the start is also written to a file
+// in the temp directory the user can open, and the middle is dropped from
+// memory. Those files are deleted when the process exits.
+class OutputCapture {
+public:
+    explicit OutputCapture(size_t max_bytes = 0); // 0 keeps everything in memory
+
+    void append(const std::string& data);
+    // Close the spill file; call once the command has exited
+    void finish();
+
+    bool truncated() const { return dropped_bytes > 0; }
+    unsigned long long totalBytes() const { return total_bytes; }
+    unsigned long long totalLines() const { return total_lines; }
+    unsigned long long droppedBytes() const { return dropped_bytes; }
+    unsigned long long droppedLines() const;
+    const std::string& head() const { return head_text; }
+    const std::string& tail() const { return tail_text; }
+    // Full output, when truncated and the file could be written; else empty
+    const std::string& spillPath() const { return spill_path; }
+
+    // Head and tail joined by a one-line note of what is missing between them
+    std::string text() const;
+
+private:
+    void spill(const std::string& data);
+
+    size_t max_bytes;
+    std::string head_text;
+    std::string tail_text;
+    unsigned long long total_bytes = 0;
+    unsigned long long total_lines = 0;  // newline characters seen
+    unsigned long long dropped_bytes = 0;
+    std::string spill_path;
+    std::shared_ptr<FILE> spill_file;
+};
+
+// The output as it goes into a prompt: ANSI escape sequences stripped,
+// carriage-return redraws (progress bars) reduced to their final state, runs
+// of three or more identical lines folded into one plus a count, and at most
+// max_lines lines (0 = no limit) kept from the head and the tail. Every cut
+// is stated in the text, with the spill file when there is one.
+std::string compactOutput(const OutputCapture& capture, size_t max_lines);
+
+// Delete spill files left in the temp directory by sessions that did not
+// exit cleanly, once they are older than retention_s seconds. Files of a
+// process that is still running are kept whatever their age.
+void removeStaleSpillFiles(int retention_s);
+
+#endif // ORI_OUTPUT_H
@@ -0,0 +1,133 @@
+#ifndef ORI_PROTOCOL_H
+#define ORI_PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <json/json.h>
+
+// Message roles are interned: a message stores one byte instead of its own
+// copy of "system"/"user"/"assistant".
+enum class ChatRole : unsigned char { System, User, Assistant };
+
+const char* chatRoleName(ChatRole role);
+
+// One conversation turn. The content is moved in once and never copied after
+// that (history entries can be megabytes of command output), so the type is
+// move-only to turn accidental copies into compile errors.
+struct ChatMessage {
+    ChatRole role;
+    std::string content;
+    bool tool_output; // command output or file contents; elided first when over budget
+    bool cache_breakpoint = false; // ends a stable prefix worth caching (system prompt, pinned files)
+
+    ChatMessage(ChatRole role, std::string content, bool tool_output = false)
+        : role(role), content(std::move(content)), tool_output(tool_output) {}
+    ChatMessage(ChatMessage&&) = default;
+    ChatMessage& operator=(ChatMessage&&) = default;
+    ChatMessage(const ChatMessage&) = delete;
+    ChatMessage& operator=(const ChatMessage&) = delete;
+};
+
+// Append `text` to `out` as a quoted JSON string. Invalid UTF-8 (binary
+// command output) is replaced with U+FFFD so the request stays valid JSON.
+void appendJsonString(std::string& out, const std::string& text);
+
+// A request body kept as a list of immutable, shared chunks. Building the next
+// request only adds pointers to chunks that already exist; curl pulls the
+// bytes through read() without the body ever being flattened.
+class RequestBody {
+public:
+    void append(std::string text);
+    void append(std::shared_ptr<const std::string> chunk);
+
+    size_t size() const { return total; }
+    const std::vector<std::shared_ptr<const std::string>>& parts() const { return chunks; }
+    // Flattened copy, for debug output and anything that needs contiguous bytes.
+    std::string str() const;
+
+    // Restart reading from the first byte (before each retry).
+    void rewind();
+
+    // CURLOPT_READFUNCTION / CURLOPT_SEEKFUNCTION adapters; userdata is the RequestBody.
+    static size_t read(char* buffer, size_t size, size_t nitems, void* userdata);
+    static int seek(void* userdata, long long offset, int origin);
+
+private:
+    std::vector<std::shared_ptr<const std::string>> chunks;
+    size_t total = 0;
+    size_t chunk_index = 0;
+    size_t chunk_offset = 0;
+};
+
+// Serialized JSON of every message in a conversation, cached per message so
+// each turn only escapes what was added since the previous request.
+class HistorySerializer {
+public:
+    // Serialize the messages of `history` that are not cached yet. With
+    // cache_hints, messages marked cache_breakpoint carry a cache_control
+    // hint; toggling it re-serializes everything.
+    void sync(const std::vector<ChatMessage>& history, bool cache_hints = false);
+    // Forget cached entries from `index` on; call whenever the history is
+    // rewritten (cleared, compacted or edited) at or after that position.
+    void invalidateFrom(size_t index);
+    // Append the comma-separated message objects to `body`.
+    void appendTo(RequestBody& body) const;
+
+    size_t cachedCount() const { return entries.size(); }
+
+private:
+    std::vector<std::shared_ptr<const std::string>> entries;
+    bool hints = false;
+};
+
+// Prompt caching. OpenAI-style providers cache long prefixes on their own;
+// Anthropic and Gemini models only do so up to a message whose content part
+// carries "cache_control", and honour at most this many such breakpoints.
+const size_t MAX_CACHE_BREAKPOINTS = 4;
+bool modelTakesCacheHints(const std::string& model);
+
+// Prompt tokens of a reply and how many of them the provider served from its
+// prefix cache, read from a "usage" object in any of the common shapes.
+// Returns false when usage has no prompt token count.
+bool promptTokenUsage(const Json::Value& usage, long long& prompt_tokens, long long& cached_tokens);
+
+// Incremental parser for the server-sent-event body returned by the
+// chat-completions endpoint when a request sets "stream": true. Bytes are fed
+// in exactly as curl hands them over; every content delta is forwarded to the
+// token callback and also accumulated so the caller can record the full reply.
+class SseParser {
+public:
+    using TokenCallback = std::function<void(const std::string&)>;
+
+    explicit SseParser(TokenCallback on_token);
+
+    void feed(const char* data, size_t len);
+    void reset();
+
+    // True once at least one "data:" event was decoded. A response without
+    // events is a plain JSON body (typically an error) and is kept in raw().
+    bool sawEvents() const { return saw_events; }
+    bool finished() const { return done; }
+    const std::string& text() const { return content; }
+    const std::string& raw() const { return raw_body; }
+    // Non-null when the stream carried an {"error": {...}} event.
+    const Json::Value& error() const { return error_obj; }
+    // The "usage" object from the final chunk, if the provider sent one.
+    const Json::Value& usage() const { return usage_obj; }
+
+private:
+    void handleLine(const std::string& line);
+
+    TokenCallback on_token;
+    std::string line_buffer;
+    std::string content;
+    std::string raw_body;
+    Json::Value error_obj;
+    Json::Value usage_obj;
+    bool saw_events = false;
+    bool done = false;
+};
+
+#endif // ORI_PROTOCOL_H
@@ -0,0 +1,103 @@
+#ifndef ORI_RETRY_H
+#define ORI_RETRY_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <json/json.h>
+
+// How often and how long a chat request is retried.
+struct RetryPolicy {
+    int max_attempts = 5;
+    long base_delay_ms = 500;       // first backoff window; doubles per attempt
+    long max_delay_ms = 20000;      // cap on the backoff window
+    long max_retry_after_ms = 60000; // a longer Retry-After is reported instead of waited out
+};
+
+// Rate-limit hints read from response headers through headerCallback().
+struct RetryHints {
+    long retry_after_ms = -1;   // Retry-After; -1 when the server sent no usable one
+    long rate_limit_reset_ms = -1; // X-RateLimit-Reset, sent on most replies
+
+    void reset() { retry_after_ms = rate_limit_reset_ms = -1; }
+
+    // The wait a response with this status asks for, or -1. Retry-After
+    // counts for 429 and 503; X-RateLimit-Reset only for 429, as it is the
+    // end of the rate window (hours away for daily quotas), not advice for
+    // an unrelated 5xx.
+    long delayFor(long http_code) const {
+        if (http_code == 429) return retry_after_ms >= 0 ? retry_after_ms : rate_limit_reset_ms;
+        if (http_code == 503) return retry_after_ms;
+        return -1;
+    }
+
+    // CURLOPT_HEADERFUNCTION adapter; userdata is a RetryHints. Understands
+    // Retry-After (seconds or HTTP date) and X-RateLimit-Reset (epoch time).
+    static size_t headerCallback(char* buffer, size_t size, size_t nitems, void* userdata);
+};
+
+// Milliseconds until the time given by a Retry-After value, or -1.
+long parseRetryAfter(const std::string& value);
+
+// Backoff before retry number `attempt` (1-based). With a server hint the
+// wait is the hint plus a little jitter; otherwise it is "full jitter":
+// uniform in [0, min(max_delay, base * 2^(attempt-1))], which keeps clients
+// that failed together from retrying together.
+long backoffDelayMs(int attempt, const RetryPolicy& policy, long retry_after_ms);
+
+// Per-model circuit breakers, shared by every request in the process. After
+// FAILURE_THRESHOLD consecutive upstream failures (5xx or transport errors) a
+// model's breaker opens and requests fail fast. Once the cool-down passes a
+// single probe request is let through; its outcome closes the breaker or
+// reopens it with a doubled cool-down.
+class UpstreamHealth {
+public:
+    enum class Outcome {
+        Success, // the upstream answered (any 2xx or a client error)
+        Failure, // 5xx or transport error: counts towards opening the breaker
+        Neutral  // e.g. 429; says nothing about whether the model is up
+    };
+
+    static constexpr int FAILURE_THRESHOLD = 5;
+    static constexpr long BASE_OPEN_MS = 30000;
+    static constexpr long MAX_OPEN_MS = 300000;
+
+    static UpstreamHealth& instance();
+
+    // 0 if a request to `model` may go ahead, otherwise the milliseconds
+    // until the breaker lets a probe through.
+    long admit(const std::string& model);
+    void record(const std::string& model, Outcome outcome, const std::string& detail = "");
+    void recordRetry(const std::string& model, const std::string& reason, long delay_ms);
+    // A hedged request fired at a fallback model, or a fallback's reply was used.
+    void recordHedge(bool won);
+
+    // Breaker and retry state of every model seen so far, for the GUI.
+    Json::Value snapshot() const;
+
+private:
+    UpstreamHealth() = default;
+
+    enum class State { Closed, Open, HalfOpen };
+    struct Breaker {
+        State state = State::Closed;
+        int consecutive_failures = 0;
+        int times_opened = 0;        // consecutive openings; sets the cool-down
+        long long open_until_ms = 0;
+        bool probe_in_flight = false;
+        std::string last_error;
+        unsigned long long retries = 0;
+        long last_retry_delay_ms = 0;
+        std::string last_retry_reason;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, Breaker> breakers;
+    std::atomic<unsigned long long> total_retries{0};
+    std::atomic<unsigned long long> fast_failures{0};
+    std::atomic<unsigned long long> hedges_fired{0};
+    std::atomic<unsigned long long> hedges_won{0};
+};
+
+#endif // ORI_RETRY_H
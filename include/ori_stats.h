@@ -0,0 +1,67 @@
+#ifndef ORI_STATS_H
+#define ORI_STATS_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <json/json.h>
+
+// Where the time of one HTTP transfer (one leg of one attempt) went, split
+// into consecutive phases from libcurl's CURLINFO_*_TIME_T values. A
+// reused connection shows zero DNS, connect and TLS time.
+struct TransferSample {
+    std::string model;
+    int attempt = 0;          // 0 for the first try, 1 for the first retry...
+    long http_code = 0;
+    int curl_result = 0;      // CURLcode
+    bool used = false;        // this transfer's reply was the one kept
+    bool new_connection = false;
+    double dns_ms = 0;        // name lookup
+    double connect_ms = 0;    // TCP (or Unix socket) connect
+    double tls_ms = 0;        // TLS handshake
+    double send_ms = 0;       // from connected to request sent
+    double wait_ms = 0;       // request sent to first response byte: queueing and prompt processing
+    double receive_ms = 0;    // first to last byte: generation, when streaming
+    double total_ms = 0;
+    unsigned long long bytes_up = 0;   // on the wire
+    unsigned long long bytes_down = 0; // on the wire
+};
+
+// One sendQuery as the caller saw it
+struct QuerySample {
+    std::string model;
+    bool ok = false;
+    int retries = 0;
+    double total_ms = 0;      // from the request being queued to the reply being handed over
+    long long prompt_tokens = -1;     // -1 when the provider sent no usage
+    long long completion_tokens = -1;
+    long long cached_tokens = 0;
+};
+
+// Rolling window of recent transfers and queries, process-wide. Reports
+// percentiles per phase and a latency histogram over what is in the window.
+class RequestStats {
+public:
+    static const size_t MAX_TRANSFERS = 512;
+    static const size_t MAX_QUERIES = 256;
+
+    static RequestStats& instance();
+
+    void recordTransfer(TransferSample sample);
+    void recordQuery(QuerySample sample);
+
+    Json::Value snapshot() const;
+    // Plain-text table for the terminal (/stats)
+    std::string report() const;
+
+private:
+    RequestStats() = default;
+
+    mutable std::mutex mutex;
+    std::deque<TransferSample> transfers;
+    std::deque<QuerySample> queries;
+    unsigned long long transfers_total = 0;
+    unsigned long long queries_total = 0;
+};
+
+#endif // ORI_STATS_H
@@ -0,0 +1,49 @@
+#ifndef ORI_UPDATE_H
+#define ORI_UPDATE_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+
+// Looks for a newer release without holding up startup. The version fetch
+// runs on the shared network loop with a short timeout, and its result is
+// kept in a small JSON file so the network is asked at most once per TTL,
+// whether the fetch worked or not (an air-gapped host pays it once a day).
+class UpdateChecker {
+public:
+    static const long CHECK_TTL_SECONDS = 86400;
+    static const long BACKGROUND_TIMEOUT_MS = 3000;
+    static const long INTERACTIVE_TIMEOUT_MS = 10000;
+
+    UpdateChecker();
+
+    // Start a check unless the cached result is younger than the TTL; either
+    // way returns at once. cache_path is usually ~/.config/ori/update_check.json.
+    void startBackground(const std::string& cache_path);
+
+    // "A new version..." text once a finished check found a newer release,
+    // handed out only once; empty otherwise. Thread-safe.
+    std::string takeNotice();
+    bool noticePending();
+
+    // Blocking fetch of the latest release version (empty on failure); also
+    // refreshes the cache when cache_path is set.
+    static std::string fetchLatest(long timeout_ms, const std::string& cache_path = "");
+
+    // The version this binary reports (.version in the working directory
+    // overrides the built-in one).
+    static std::string currentVersion();
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::string latest;
+        bool notified = false;
+    };
+    static void offer(State& state, const std::string& latest);
+    static void writeCache(const std::string& cache_path, const std::string& latest);
+
+    std::shared_ptr<State> state; // shared with a fetch that may outlive us
+};
+
+#endif // ORI_UPDATE_H
@@ -0,0 +1,125 @@
+#include "ori_backend.h"
+#include <cstdlib>
+
+namespace {
+const char* const OPENROUTER_BASE_URL = "https://openrouter.ai/api/v1";
+const std::string CHAT_PATH = "/chat/completions";
+const std::string HEADER_AUTH_PREFIX = "header:";
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void readStringMap(const Json::Value& value, std::map<std::string, std::string>& out) {
+    if (!value.isObject()) return;
+    for (const auto& key : value.getMemberNames()) {
+        out[key] = value[key].asString();
+    }
+}
+
+Json::Value writeStringMap(const std::map<std::string, std::string>& values) {
+    Json::Value out(Json::objectValue);
+    for (const auto& entry : values) out[entry.first] = entry.second;
+    return out;
+}
+}
+
+BackendProfile BackendProfile::openRouter() {
+    BackendProfile profile;
+    profile.name = "openrouter";
+    profile.base_url = OPENROUTER_BASE_URL;
+    return profile;
+}
+
+BackendProfile BackendProfile::fromJson(const std::string& name, const Json::Value& value) {
+    BackendProfile profile;
+    profile.name = name;
+    profile.base_url = value.get("base_url", "").asString();
+    profile.auth = value.get("auth", "bearer").asString();
+    profile.api_key = value.get("api_key", "").asString();
+    profile.api_key_env = value.get("api_key_env", "").asString();
+    readStringMap(value["headers"], profile.headers);
+    readStringMap(value["models"], profile.models);
+    profile.unix_socket = value.get("unix_socket", "").asString();
+    return profile;
+}
+
+Json::Value BackendProfile::toJson() const {
+    Json::Value value(Json::objectValue);
+    value["base_url"] = base_url;
+    value["auth"] = auth;
+    if (!api_key.empty()) value["api_key"] = api_key;
+    if (!api_key_env.empty()) value["api_key_env"] = api_key_env;
+    if (!headers.empty()) value["headers"] = writeStringMap(headers);
+    if (!models.empty()) value["models"] = writeStringMap(models);
+    if (!unix_socket.empty()) value["unix_socket"] = unix_socket;
+    return value;
+}
+
+std::string BackendProfile::chatUrl() const {
+    if (endsWith(base_url, CHAT_PATH)) return base_url;
+    std::string url = base_url;
+    while (!url.empty() && url.back() == '/') url.pop_back();
+    return url + CHAT_PATH;
+}
+
+std::string BackendProfile::configuredKey() const {
+    if (!api_key.empty()) return api_key;
+    if (!api_key_env.empty()) {
+        const char* env_key = std::getenv(api_key_env.c_str());
+        if (env_key != nullptr) return env_key;
+    }
+    return "";
+}
+
+std::string BackendProfile::mapModel(const std::string& model) const {
+    auto it = models.find(model);
+    if (it != models.end()) return it->second;
+    it = models.find("*");
+    return it != models.end() ? it->second : model;
+}
+
+std::vector<std::string> BackendProfile::requestHeaders(const std::string& key) const {
+    std::vector<std::string> lines;
+    if (auth == "bearer") {
+        lines.push_back("Authorization: Bearer " + key);
+    } else if (auth.compare(0, HEADER_AUTH_PREFIX.size(), HEADER_AUTH_PREFIX) == 0) {
+        lines.push_back(auth.substr(HEADER_AUTH_PREFIX.size()) + ": " + key);
+    }
+    for (const auto& header : headers) {
+        lines.push_back(header.first + ": " + header.second);
+    }
+    return lines;
+}
+
+bool resolveBackend(const std::string& name, const std::map<std::string, BackendProfile>& profiles,
+                    const std::string& api_url, BackendProfile& out, std::string& error) {
+    if (name.empty() || name == "openrouter") {
+        // A "backends" entry may still tune the built-in profile (extra headers, say)
+        auto custom = profiles.find("openrouter");
+        out = custom != profiles.end() ? custom->second : BackendProfile::openRouter();
+        out.name = "openrouter";
+        if (out.base_url.empty()) out.base_url = OPENROUTER_BASE_URL;
+        if (!api_url.empty()) out.base_url = api_url;
+        return true;
+    }
+
+    auto it = profiles.find(name);
+    if (it == profiles.end()) {
+        error = "Error: unknown backend \"" + name + "\"; define it under \"backends\" in config.json";
+        return false;
+    }
+    out = it->second;
+    if (out.base_url.compare(0, 7, "http://") != 0 && out.base_url.compare(0, 8, "https://") != 0) {
+        error = "Error: backend \"" + name + "\" needs an http:// or https:// base_url";
+        return false;
+    }
+    if (out.auth != "bearer" && out.auth != "none" &&
+        (out.auth.compare(0, HEADER_AUTH_PREFIX.size(), HEADER_AUTH_PREFIX) != 0 ||
+         out.auth.size() == HEADER_AUTH_PREFIX.size())) {
+        error = "Error: backend \"" + name + "\" has unknown auth \"" + out.auth +
+                "\" (use bearer, none or header:<Name>)";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,277 @@
+#include "ori_batch.h"
+#include "ori_retry.h"
+#include "ori_net.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <json/json.h>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct BatchItem {
+    size_t line = 0;            // 1-based line in the input file
+    std::string id;             // "id" from the input, or the line number
+    std::string prompt;
+    std::string model;
+    std::string system_prompt;
+    std::string input_error;    // set for lines that cannot be sent at all
+
+    int attempts = 0;
+    int retries = 0;            // request-level retries summed over all attempts
+    Clock::time_point started;
+    double latency_ms = 0;      // of the last attempt
+    std::string reply;
+    OpenRouterAPI::QueryStats stats;
+    std::unique_ptr<OpenRouterAPI> api;
+};
+
+std::string compactJson(const Json::Value& value) {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    builder["emitUTF8"] = true;
+    return Json::writeString(builder, value);
+}
+
+bool parseJsonLine(const std::string& line, Json::Value& value) {
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    return reader->parse(line.data(), line.data() + line.size(), &value, &errors);
+}
+
+bool blankLine(const std::string& line) {
+    return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+BatchItem parseItem(const std::string& line, size_t line_number) {
+    BatchItem item;
+    item.line = line_number;
+    item.id = std::to_string(line_number);
+    Json::Value value;
+    if (!parseJsonLine(line, value) || !value.isObject()) {
+        item.input_error = "Error: line " + std::to_string(line_number) + " is not a JSON object";
+        return item;
+    }
+    if (value.isMember("id") && (value["id"].isString() || value["id"].isIntegral())) {
+        item.id = value["id"].asString();
+    }
+    item.prompt = value.get("prompt", "").asString();
+    item.model = value.get("model", "").asString();
+    item.system_prompt = value.get("system", value.get("system_prompt", "")).asString();
+    if (item.prompt.empty()) {
+        item.input_error = "Error: line " + std::to_string(line_number) + " has no \"prompt\"";
+    }
+    return item;
+}
+
+// Ids with a successful result in an earlier run's output
+std::set<std::string> completedIds(const std::string& path) {
+    std::set<std::string> done;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        Json::Value value;
+        if (parseJsonLine(line, value) && value.isObject() && value.get("ok", false).asBool()) {
+            done.insert(value.get("id", "").asString());
+        }
+    }
+    return done;
+}
+
+Json::Value resultLine(const BatchItem& item) {
+    Json::Value result;
+    result["id"] = item.id;
+    result["line"] = static_cast<Json::UInt64>(item.line);
+    const bool ok = item.input_error.empty() && item.stats.ok;
+    result["ok"] = ok;
+    if (ok) {
+        result["model"] = item.stats.model;
+        result["response"] = item.reply;
+    } else {
+        result["error"] = item.input_error.empty() ? item.stats.error : item.input_error;
+    }
+    result["latency_ms"] = static_cast<Json::Int64>(item.latency_ms + 0.5);
+    result["attempts"] = item.attempts;
+    result["retries"] = item.retries;
+    result["cached"] = item.stats.cached;
+    result["usage"] = item.stats.usage.isObject() ? item.stats.usage : Json::Value(Json::objectValue);
+    return result;
+}
+}
+
+int runBatch(const BatchOptions& options, const Config& config, const BackendProfile& backend,
+             const std::string& api_key, const std::string& default_system_prompt) {
+    std::ifstream input(options.input_path);
+    if (!input) {
+        std::cerr << "Error: cannot read batch input " << options.input_path << std::endl;
+        return 1;
+    }
+
+    // The output doubles as the checkpoint: skip what an earlier run finished
+    std::set<std::string> already_done = completedIds(options.output_path);
+    std::vector<std::unique_ptr<BatchItem>> items;
+    std::set<std::string> seen_ids;
+    size_t skipped = 0;
+    std::string line;
+    for (size_t line_number = 1; std::getline(input, line); ++line_number) {
+        if (blankLine(line)) continue;
+        std::unique_ptr<BatchItem> item(new BatchItem(parseItem(line, line_number)));
+        if (already_done.count(item->id)) {
+            skipped++;
+            continue;
+        }
+        if (!seen_ids.insert(item->id).second) {
+            std::cerr << YELLOW << "Warning: duplicate id \"" << item->id << "\" on line " << line_number
+                      << "; resuming will treat both lines as one item" << RESET << std::endl;
+        }
+        items.push_back(std::move(item));
+    }
+
+    // Finish a line a crashed run may have left half-written
+    bool needs_newline = false;
+    {
+        std::ifstream existing(options.output_path, std::ios::binary | std::ios::ate);
+        if (existing && existing.tellg() > 0) {
+            existing.seekg(-1, std::ios::end);
+            needs_newline = existing.get() != '\n';
+        }
+    }
+    std::ofstream output(options.output_path, std::ios::app);
+    if (!output) {
+        std::cerr << "Error: cannot write batch output " << options.output_path << std::endl;
+        return 1;
+    }
+    if (needs_newline) output << '\n';
+
+    const int concurrency = options.concurrency > 0 ? options.concurrency : 1;
+    const int max_attempts = options.max_attempts > 0 ? options.max_attempts : 1;
+    std::cerr << "Batch: " << items.size() << " prompts, " << skipped << " already done, concurrency "
+              << concurrency << std::endl;
+
+    // Replies arrive on the network thread; this thread launches items, waits
+    // out retry delays and writes results, so the output needs no locking.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<BatchItem*> ready;
+    std::multimap<Clock::time_point, BatchItem*> delayed;
+    std::deque<BatchItem*> settled;
+    int in_flight = 0;
+    for (auto& item : items) {
+        (item->input_error.empty() ? ready : settled).push_back(item.get());
+    }
+
+    auto on_reply = [&](BatchItem* item, const std::string& reply) {
+        std::lock_guard<std::mutex> lock(mutex);
+        item->latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - item->started).count();
+        item->stats = item->api->lastQueryStats();
+        item->retries += item->stats.retries;
+        item->reply = reply;
+        in_flight--;
+        if (!item->stats.ok && item->attempts < max_attempts) {
+            long delay_ms = backoffDelayMs(item->attempts, RetryPolicy(), -1);
+            delayed.emplace(Clock::now() + std::chrono::milliseconds(delay_ms), item);
+        } else {
+            settled.push_back(item);
+        }
+        changed.notify_one();
+    };
+
+    auto launch = [&](BatchItem* item) {
+        // A fresh conversation per attempt: a failed one already holds the prompt
+        item->api.reset(new OpenRouterAPI());
+        OpenRouterAPI& api = *item->api;
+        api.setApiKey(api_key);
+        api.setBackend(backend);
+        api.setCompressRequests(config.compress_requests);
+        api.setContextConfig(config);
+        api.setHedgeConfig(config);
+        api.setModel(item->model.empty() ? config.model : item->model);
+        api.setSystemPrompt(item->system_prompt.empty() ? default_system_prompt : item->system_prompt);
+        item->attempts++;
+        item->started = Clock::now();
+        api.sendQueryAsync(item->prompt, nullptr, [&on_reply, item](const std::string& reply) {
+            on_reply(item, reply);
+        });
+    };
+
+    const auto batch_start = Clock::now();
+    size_t written = 0, succeeded = 0;
+    bool interrupted = false;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        while (!settled.empty()) {
+            BatchItem* item = settled.front();
+            settled.pop_front();
+            lock.unlock();
+            Json::Value result = resultLine(*item);
+            output << compactJson(result) << '\n' << std::flush;
+            written++;
+            if (result["ok"].asBool()) succeeded++;
+            std::cerr << "[" << written << "/" << items.size() << "] " << item->id << " "
+                      << (result["ok"].asBool() ? "ok" : "failed: " + result["error"].asString()) << " ("
+                      << result["latency_ms"].asInt64() << " ms)" << std::endl;
+            item->api.reset();
+            item->reply.clear();
+            lock.lock();
+        }
+
+        if (OriAssistant::interrupted_flag && !interrupted) {
+            interrupted = true;
+            std::cerr << YELLOW << "Interrupted: waiting for " << in_flight
+                      << " requests in flight; rerun the same command to resume" << RESET << std::endl;
+        }
+        if (interrupted) {
+            ready.clear();
+            delayed.clear();
+        }
+
+        const auto now = Clock::now();
+        while (!delayed.empty() && delayed.begin()->first <= now) {
+            ready.push_back(delayed.begin()->second);
+            delayed.erase(delayed.begin());
+        }
+        if (in_flight < concurrency && !ready.empty()) {
+            BatchItem* item = ready.front();
+            ready.pop_front();
+            in_flight++;
+            lock.unlock();
+            launch(item);
+            lock.lock();
+            continue;
+        }
+        if (in_flight == 0 && ready.empty() && delayed.empty() && settled.empty()) break;
+
+        // Wake for a reply, the next retry, or to notice Ctrl-C
+        auto wake = now + std::chrono::milliseconds(200);
+        if (!delayed.empty() && delayed.begin()->first < wake) wake = delayed.begin()->first;
+        changed.wait_until(lock, wake);
+    }
+    lock.unlock();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - batch_start).count();
+    std::cerr << "Batch finished: " << succeeded << " ok, " << (written - succeeded) << " failed, " << skipped
+              << " skipped in " << std::fixed << std::setprecision(1) << seconds << "s" << std::endl;
+    Json::Value transfer = TransferCounters::instance().snapshot();
+    auto kib = [](const Json::Value& bytes) { return bytes.asDouble() / 1024.0; };
+    std::cerr << "Sent " << kib(transfer["upload"]["logical_bytes"]) << " KiB as "
+              << kib(transfer["upload"]["wire_bytes"]) << " KiB on the wire, received "
+              << kib(transfer["download"]["logical_bytes"]) << " KiB as "
+              << kib(transfer["download"]["wire_bytes"]) << " KiB" << std::endl;
+    Json::Value prompt_cache = PromptCacheCounters::instance().snapshot();
+    if (prompt_cache["replies"].asUInt64() > 0) {
+        std::cerr << "Prompt tokens: " << prompt_cache["prompt_tokens"].asUInt64() << ", "
+                  << prompt_cache["cached_tokens"].asUInt64() << " served from the provider's cache ("
+                  << std::setprecision(0) << prompt_cache["hit_ratio"].asDouble() * 100 << "%)" << std::endl;
+    }
+    return (interrupted || succeeded != written) ? 1 : 0;
+}
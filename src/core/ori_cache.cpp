@@ -0,0 +1,203 @@
+#include "ori_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <json/json.h>
+
+namespace {
+long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+}
+
+ResponseCache& ResponseCache::instance() {
+    static ResponseCache cache;
+    return cache;
+}
+
+void ResponseCache::configure(bool enabled, long ttl_seconds, size_t max_memory_entries, const std::string& dir) {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_enabled = enabled;
+    ttl = ttl_seconds > 0 ? ttl_seconds : 0;
+    max_entries = max_memory_entries > 0 ? max_memory_entries : 1;
+    cache_dir = dir;
+    while (lru.size() > max_entries) {
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+}
+
+std::string ResponseCache::keyFor(const RequestBody& body) {
+    // Two independent FNV-1a lanes give a 128-bit digest; plenty for a cache key
+    unsigned long long a = 0xcbf29ce484222325ULL;
+    unsigned long long b = 0x84222325cbf29ce4ULL;
+    for (const auto& part : body.parts()) {
+        for (unsigned char c : *part) {
+            a = (a ^ c) * 0x100000001b3ULL;
+            b = (b ^ c) * 0x100000001b3ULL;
+            b ^= b >> 29;
+        }
+    }
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", a, b);
+    return std::string(hex);
+}
+
+std::string ResponseCache::diskPath(const std::string& key) const {
+    return cache_dir + "/" + key + ".json";
+}
+
+bool ResponseCache::readDisk(const std::string& path, long ttl_s, std::string& reply, long long& created) {
+    if (path.empty()) return false;
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errs;
+    if (!Json::parseFromStream(builder, file, &root, &errs) || !root["reply"].isString()) {
+        file.close();
+        std::remove(path.c_str());
+        return false;
+    }
+    created = root.get("created", 0).asInt64();
+    if (ttl_s > 0 && unix_now() - created > ttl_s) {
+        file.close();
+        std::remove(path.c_str());
+        return false;
+    }
+    reply = root["reply"].asString();
+    return true;
+}
+
+void ResponseCache::writeDisk(const std::string& path, const std::string& reply, long long created) {
+    if (path.empty()) return;
+    // Entries hold conversation replies: keep the directory and files private
+    std::error_code ec;
+    const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (std::filesystem::create_directories(dir, ec)) {
+        std::filesystem::permissions(dir, std::filesystem::perms::owner_all, ec);
+    }
+
+    Json::Value root;
+    root["created"] = static_cast<Json::Int64>(created);
+    root["reply"] = reply;
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+
+    // Write to a temp file and rename so readers never see a partial entry
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) return;
+    FILE* file = fdopen(fd, "w");
+    if (!file) {
+        close(fd);
+        return;
+    }
+    const std::string text = Json::writeString(writer, root);
+    bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    written = std::fclose(file) == 0 && written;
+    if (written) {
+        std::rename(tmp_path.c_str(), path.c_str());
+    } else {
+        std::remove(tmp_path.c_str());
+    }
+}
+
+void ResponseCache::rememberLocked(const std::string& key, const std::string& reply, long long created) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+        lru.erase(it->second);
+    }
+    lru.push_front({key, reply, created});
+    index[key] = lru.begin();
+    while (lru.size() > max_entries) {
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+}
+
+bool ResponseCache::lookupMemoryLocked(const std::string& key, std::string& reply) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+        if (ttl > 0 && unix_now() - it->second->created > ttl) {
+            lru.erase(it->second);
+            index.erase(it);
+        } else {
+            lru.splice(lru.begin(), lru, it->second);
+            reply = lru.front().reply;
+            memory_hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+ResponseCache::Lookup ResponseCache::acquire(const std::string& key, std::string& reply, Waiter waiter) {
+    std::string path;
+    long ttl_s;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (lookupMemoryLocked(key, reply)) return Lookup::Hit;
+        if (!cache_dir.empty()) path = diskPath(key);
+        ttl_s = ttl;
+    }
+
+    // File I/O and parsing without the lock, so other lookups are not held up
+    std::string disk_reply;
+    long long created = 0;
+    bool on_disk = readDisk(path, ttl_s, disk_reply, created);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Another thread may have stored the reply or started the request meanwhile
+    if (lookupMemoryLocked(key, reply)) return Lookup::Hit;
+    if (on_disk) {
+        rememberLocked(key, disk_reply, created);
+        reply = std::move(disk_reply);
+        disk_hits++;
+        return Lookup::Hit;
+    }
+
+    auto it = in_flight.find(key);
+    if (it == in_flight.end()) {
+        in_flight[key] = std::make_shared<Flight>();
+        misses++;
+        return Lookup::Miss;
+    }
+    it->second->waiters.push_back(std::move(waiter));
+    return Lookup::Joined;
+}
+
+void ResponseCache::complete(const std::string& key, bool ok, const std::string& reply) {
+    long long created = unix_now();
+    std::shared_ptr<Flight> flight;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!cache_dir.empty()) path = diskPath(key);
+        auto it = in_flight.find(key);
+        if (it != in_flight.end()) {
+            flight = it->second;
+            in_flight.erase(it);
+        }
+        if (ok) {
+            rememberLocked(key, reply, created);
+        }
+    }
+    if (ok) {
+        writeDisk(path, reply, created);
+    }
+    // Outside the lock: a waiter whose request failed calls acquire() again
+    if (!flight) return;
+    if (ok) shared_flights += flight->waiters.size();
+    for (auto& waiter : flight->waiters) waiter(ok, reply);
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+    return {memory_hits.load(), disk_hits.load(), shared_flights.load(), misses.load()};
+}
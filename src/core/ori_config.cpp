@@ -1,12 +1,15 @@
 #include "ori_core.h"
+#include <algorithm>
 #include <fstream>
+#include <iostream>
+#include <sstream>
 #include <json/json.h>
 #include <sys/stat.h>
 #include <filesystem>
 #include <functional>
 #include <unordered_map>
 
-Config::Config() : port(8080), no_banner(false), no_clear(false), model("google/gemini-2.0-flash-exp:free"), debug(false) {}
+Config::Config() : port(8080), no_banner(false), no_clear(false), model("google/gemini-2.0-flash-exp:free"), debug(false), prewarm(true), stream(true), context_budget(32000), context_keep_recent(6), context_compact(true), cache(false), cache_ttl(86400), cache_entries(256), hedge_models(""), hedge_delay_ms(4000), api_url(""), compress_requests(false), prompt_cache(true), backend(""), exec_parallelism(4), exec_output_bytes(32768), exec_output_lines(300), exec_log_retention(3600), exec_timeout(0), exec_cpu_seconds(0), exec_memory_mb(0), exec_max_output(0), exec_max_processes(0), exec_persistent_shell(false) {}
 
 ConfigManager::ConfigManager() {
     const char* home_dir = getenv("HOME");
@@ -34,6 +37,42 @@ void ConfigManager::loadConfig(Config& config) {
     config.no_clear = root.get("no_clear", true).asBool();
     config.model = root.get("model", "qwen/qwen3-coder:free").asString();
     config.debug = root.get("debug", false).asBool();
+    config.prewarm = root.get("prewarm", true).asBool();
+    config.stream = root.get("stream", true).asBool();
+    config.context_budget = root.get("context_budget", 32000).asInt();
+    config.context_budgets.clear();
+    if (root["context_budgets"].isObject()) {
+        for (const auto& name : root["context_budgets"].getMemberNames()) {
+            config.context_budgets[name] = root["context_budgets"][name].asInt();
+        }
+    }
+    config.context_keep_recent = root.get("context_keep_recent", 6).asInt();
+    config.context_compact = root.get("context_compact", true).asBool();
+    config.cache = root.get("cache", false).asBool();
+    config.cache_ttl = root.get("cache_ttl", 86400).asInt();
+    config.cache_entries = root.get("cache_entries", 256).asInt();
+    config.hedge_models = root.get("hedge_models", "").asString();
+    config.hedge_delay_ms = root.get("hedge_delay_ms", 4000).asInt();
+    config.api_url = root.get("api_url", "").asString();
+    config.compress_requests = root.get("compress_requests", false).asBool();
+    config.prompt_cache = root.get("prompt_cache", true).asBool();
+    config.exec_parallelism = root.get("exec_parallelism", 4).asInt();
+    config.exec_output_bytes = root.get("exec_output_bytes", 32768).asInt();
+    config.exec_output_lines = root.get("exec_output_lines", 300).asInt();
+    config.exec_log_retention = root.get("exec_log_retention", 3600).asInt();
+    config.exec_timeout = root.get("exec_timeout", 0).asInt();
+    config.exec_cpu_seconds = root.get("exec_cpu_seconds", 0).asInt();
+    config.exec_memory_mb = root.get("exec_memory_mb", 0).asInt();
+    config.exec_max_output = root.get("exec_max_output", 0).asInt();
+    config.exec_max_processes = root.get("exec_max_processes", 0).asInt();
+    config.exec_persistent_shell = root.get("exec_persistent_shell", false).asBool();
+    config.backend = root.get("backend", "").asString();
+    config.backends.clear();
+    if (root["backends"].isObject()) {
+        for (const auto& name : root["backends"].getMemberNames()) {
+            config.backends[name] = BackendProfile::fromJson(name, root["backends"][name]);
+        }
+    }
 }
 
 void ConfigManager::saveConfig(const Config& config) {
@@ -43,6 +82,38 @@ void ConfigManager::saveConfig(const Config& config) {
     root["no_clear"] = config.no_clear;
     root["model"] = config.model;
     root["debug"] = config.debug;
+    root["prewarm"] = config.prewarm;
+    root["stream"] = config.stream;
+    root["context_budget"] = config.context_budget;
+    root["context_budgets"] = Json::Value(Json::objectValue);
+    for (const auto& entry : config.context_budgets) {
+        root["context_budgets"][entry.first] = entry.second;
+    }
+    root["context_keep_recent"] = config.context_keep_recent;
+    root["context_compact"] = config.context_compact;
+    root["cache"] = config.cache;
+    root["cache_ttl"] = config.cache_ttl;
+    root["cache_entries"] = config.cache_entries;
+    root["hedge_models"] = config.hedge_models;
+    root["hedge_delay_ms"] = config.hedge_delay_ms;
+    root["api_url"] = config.api_url;
+    root["compress_requests"] = config.compress_requests;
+    root["prompt_cache"] = config.prompt_cache;
+    root["exec_parallelism"] = config.exec_parallelism;
+    root["exec_output_bytes"] = config.exec_output_bytes;
+    root["exec_output_lines"] = config.exec_output_lines;
+    root["exec_log_retention"] = config.exec_log_retention;
+    root["exec_timeout"] = config.exec_timeout;
+    root["exec_cpu_seconds"] = config.exec_cpu_seconds;
+    root["exec_memory_mb"] = config.exec_memory_mb;
+    root["exec_max_output"] = config.exec_max_output;
+    root["exec_max_processes"] = config.exec_max_processes;
+    root["exec_persistent_shell"] = config.exec_persistent_shell;
+    root["backend"] = config.backend;
+    root["backends"] = Json::Value(Json::objectValue);
+    for (const auto& entry : config.backends) {
+        root["backends"][entry.first] = entry.second.toJson();
+    }
 
     std::filesystem::path p(config_path);
     std::filesystem::create_directories(p.parent_path());
@@ -71,6 +142,42 @@ void ConfigManager::loadExternalConfig(Config& config, const std::string& path)
     config.no_clear = root.get("no_clear", false).asBool();
     config.model = root.get("model", "google/gemini-2.0-flash-exp:free").asString();
     config.debug = root.get("debug", false).asBool();
+    config.prewarm = root.get("prewarm", true).asBool();
+    config.stream = root.get("stream", true).asBool();
+    config.context_budget = root.get("context_budget", 32000).asInt();
+    config.context_budgets.clear();
+    if (root["context_budgets"].isObject()) {
+        for (const auto& name : root["context_budgets"].getMemberNames()) {
+            config.context_budgets[name] = root["context_budgets"][name].asInt();
+        }
+    }
+    config.context_keep_recent = root.get("context_keep_recent", 6).asInt();
+    config.context_compact = root.get("context_compact", true).asBool();
+    config.cache = root.get("cache", false).asBool();
+    config.cache_ttl = root.get("cache_ttl", 86400).asInt();
+    config.cache_entries = root.get("cache_entries", 256).asInt();
+    config.hedge_models = root.get("hedge_models", "").asString();
+    config.hedge_delay_ms = root.get("hedge_delay_ms", 4000).asInt();
+    config.api_url = root.get("api_url", "").asString();
+    config.compress_requests = root.get("compress_requests", false).asBool();
+    config.prompt_cache = root.get("prompt_cache", true).asBool();
+    config.exec_parallelism = root.get("exec_parallelism", 4).asInt();
+    config.exec_output_bytes = root.get("exec_output_bytes", 32768).asInt();
+    config.exec_output_lines = root.get("exec_output_lines", 300).asInt();
+    config.exec_log_retention = root.get("exec_log_retention", 3600).asInt();
+    config.exec_timeout = root.get("exec_timeout", 0).asInt();
+    config.exec_cpu_seconds = root.get("exec_cpu_seconds", 0).asInt();
+    config.exec_memory_mb = root.get("exec_memory_mb", 0).asInt();
+    config.exec_max_output = root.get("exec_max_output", 0).asInt();
+    config.exec_max_processes = root.get("exec_max_processes", 0).asInt();
+    config.exec_persistent_shell = root.get("exec_persistent_shell", false).asBool();
+    config.backend = root.get("backend", "").asString();
+    config.backends.clear();
+    if (root["backends"].isObject()) {
+        for (const auto& name : root["backends"].getMemberNames()) {
+            config.backends[name] = BackendProfile::fromJson(name, root["backends"][name]);
+        }
+    }
 }
 
 void ConfigManager::updateConfig(const std::string& key, const std::string& value) {
@@ -82,9 +189,61 @@ void ConfigManager::updateConfig(const std::string& key, const std::string& valu
         {"no_banner", [](Config& c, const std::string& v){ c.no_banner = (v == "true"); }},
         {"no_clear", [](Config& c, const std::string& v){ c.no_clear = (v == "true"); }},
         {"model", [](Config& c, const std::string& v){ c.model = v; }},
-        {"debug", [](Config& c, const std::string& v){ c.debug = (v == "true"); }}
+        {"debug", [](Config& c, const std::string& v){ c.debug = (v == "true"); }},
+        {"prewarm", [](Config& c, const std::string& v){ c.prewarm = (v == "true"); }},
+        {"stream", [](Config& c, const std::string& v){ c.stream = (v == "true"); }},
+        {"context_budget", [](Config& c, const std::string& v){ c.context_budget = std::stoi(v); }},
+        {"context_keep_recent", [](Config& c, const std::string& v){ c.context_keep_recent = std::stoi(v); }},
+        {"context_compact", [](Config& c, const std::string& v){ c.context_compact = (v == "true"); }},
+        {"cache", [](Config& c, const std::string& v){ c.cache = (v == "true"); }},
+        {"cache_ttl", [](Config& c, const std::string& v){ c.cache_ttl = std::stoi(v); }},
+        {"cache_entries", [](Config& c, const std::string& v){ c.cache_entries = std::stoi(v); }},
+        {"hedge_models", [](Config& c, const std::string& v){ c.hedge_models = v; }},
+        {"hedge_delay_ms", [](Config& c, const std::string& v){ c.hedge_delay_ms = std::stoi(v); }},
+        {"api_url", [](Config& c, const std::string& v){ c.api_url = v; }},
+        {"compress_requests", [](Config& c, const std::string& v){ c.compress_requests = (v == "true"); }},
+        {"prompt_cache", [](Config& c, const std::string& v){ c.prompt_cache = (v == "true"); }},
+        {"exec_parallelism", [](Config& c, const std::string& v){ c.exec_parallelism = std::stoi(v); }},
+        {"exec_output_bytes", [](Config& c, const std::string& v){ c.exec_output_bytes = std::stoi(v); }},
+        {"exec_output_lines", [](Config& c, const std::string& v){ c.exec_output_lines = std::stoi(v); }},
+        {"exec_log_retention", [](Config& c, const std::string& v){ c.exec_log_retention = std::stoi(v); }},
+        {"exec_timeout", [](Config& c, const std::string& v){ c.exec_timeout = std::stoi(v); }},
+        {"exec_cpu_seconds", [](Config& c, const std::string& v){ c.exec_cpu_seconds = std::stoi(v); }},
+        {"exec_memory_mb", [](Config& c, const std::string& v){ c.exec_memory_mb = std::stoi(v); }},
+        {"exec_max_output", [](Config& c, const std::string& v){ c.exec_max_output = std::stoi(v); }},
+        {"exec_max_processes", [](Config& c, const std::string& v){ c.exec_max_processes = std::stoi(v); }},
+        {"exec_persistent_shell", [](Config& c, const std::string& v){ c.exec_persistent_shell = (v == "true"); }},
+        {"backend", [](Config& c, const std::string& v){ c.backend = v; }}
     };
 
+    // Per-model budgets: context_budget:<model> <tokens>
+    static const std::string model_budget_prefix = "context_budget:";
+    if (key.rfind(model_budget_prefix, 0) == 0 && key.size() > model_budget_prefix.size()) {
+        config.context_budgets[key.substr(model_budget_prefix.size())] = std::stoi(value);
+        saveConfig(config);
+        return;
+    }
+
+    // Server profiles: backend:<name> '<JSON object>' (an empty value removes one)
+    static const std::string backend_prefix = "backend:";
+    if (key.rfind(backend_prefix, 0) == 0 && key.size() > backend_prefix.size()) {
+        std::string name = key.substr(backend_prefix.size());
+        Json::Value profile;
+        Json::CharReaderBuilder reader;
+        std::istringstream in(value);
+        std::string errors;
+        if (value.empty()) {
+            config.backends.erase(name);
+        } else if (Json::parseFromStream(reader, in, &profile, &errors) && profile.isObject()) {
+            config.backends[name] = BackendProfile::fromJson(name, profile);
+        } else {
+            std::cerr << "Error: backend:" << name << " needs a JSON object" << std::endl;
+            return;
+        }
+        saveConfig(config);
+        return;
+    }
+
     auto it = updaters.find(key);
     if (it != updaters.end()) {
         it->second(config, value);
@@ -102,7 +261,45 @@ std::string ConfigManager::getConfigValue(const std::string& key) {
         {"no_banner", [](const Config& c){ return c.no_banner ? "true" : "false"; }},
         {"no_clear", [](const Config& c){ return c.no_clear ? "true" : "false"; }},
         {"model", [](const Config& c){ return c.model; }},
-        {"debug", [](const Config& c){ return c.debug ? "true" : "false"; }}
+        {"debug", [](const Config& c){ return c.debug ? "true" : "false"; }},
+        {"prewarm", [](const Config& c){ return c.prewarm ? "true" : "false"; }},
+        {"stream", [](const Config& c){ return c.stream ? "true" : "false"; }},
+        {"context_budget", [](const Config& c){ return std::to_string(c.context_budget); }},
+        {"context_budgets", [](const Config& c){
+            Json::Value budgets(Json::objectValue);
+            for (const auto& entry : c.context_budgets) budgets[entry.first] = entry.second;
+            Json::StreamWriterBuilder writer;
+            writer["indentation"] = "";
+            return Json::writeString(writer, budgets);
+        }},
+        {"context_keep_recent", [](const Config& c){ return std::to_string(c.context_keep_recent); }},
+        {"context_compact", [](const Config& c){ return c.context_compact ? "true" : "false"; }},
+        {"cache", [](const Config& c){ return c.cache ? "true" : "false"; }},
+        {"cache_ttl", [](const Config& c){ return std::to_string(c.cache_ttl); }},
+        {"cache_entries", [](const Config& c){ return std::to_string(c.cache_entries); }},
+        {"hedge_models", [](const Config& c){ return c.hedge_models; }},
+        {"hedge_delay_ms", [](const Config& c){ return std::to_string(c.hedge_delay_ms); }},
+        {"api_url", [](const Config& c){ return c.api_url; }},
+        {"compress_requests", [](const Config& c){ return c.compress_requests ? "true" : "false"; }},
+        {"prompt_cache", [](const Config& c){ return c.prompt_cache ? "true" : "false"; }},
+        {"exec_parallelism", [](const Config& c){ return std::to_string(c.exec_parallelism); }},
+        {"exec_output_bytes", [](const Config& c){ return std::to_string(c.exec_output_bytes); }},
+        {"exec_output_lines", [](const Config& c){ return std::to_string(c.exec_output_lines); }},
+        {"exec_log_retention", [](const Config& c){ return std::to_string(c.exec_log_retention); }},
+        {"exec_timeout", [](const Config& c){ return std::to_string(c.exec_timeout); }},
+        {"exec_cpu_seconds", [](const Config& c){ return std::to_string(c.exec_cpu_seconds); }},
+        {"exec_memory_mb", [](const Config& c){ return std::to_string(c.exec_memory_mb); }},
+        {"exec_max_output", [](const Config& c){ return std::to_string(c.exec_max_output); }},
+        {"exec_max_processes", [](const Config& c){ return std::to_string(c.exec_max_processes); }},
+        {"exec_persistent_shell", [](const Config& c){ return c.exec_persistent_shell ? "true" : "false"; }},
+        {"backend", [](const Config& c){ return c.backend.empty() ? std::string("openrouter") : c.backend; }},
+        {"backends", [](const Config& c){
+            Json::Value backends(Json::objectValue);
+            for (const auto& entry : c.backends) backends[entry.first] = entry.second.toJson();
+            Json::StreamWriterBuilder writer;
+            writer["indentation"] = "";
+            return Json::writeString(writer, backends);
+        }}
     };
 
     auto it = getters.find(key);
@@ -123,7 +320,49 @@ std::string ConfigManager::getAllConfig() {
     root["no_clear"] = config.no_clear;
     root["model"] = config.model;
     root["debug"] = config.debug;
+    root["prewarm"] = config.prewarm;
+    root["stream"] = config.stream;
+    root["context_budget"] = config.context_budget;
+    root["context_budgets"] = Json::Value(Json::objectValue);
+    for (const auto& entry : config.context_budgets) {
+        root["context_budgets"][entry.first] = entry.second;
+    }
+    root["context_keep_recent"] = config.context_keep_recent;
+    root["context_compact"] = config.context_compact;
+    root["cache"] = config.cache;
+    root["cache_ttl"] = config.cache_ttl;
+    root["cache_entries"] = config.cache_entries;
+    root["hedge_models"] = config.hedge_models;
+    root["hedge_delay_ms"] = config.hedge_delay_ms;
+    root["api_url"] = config.api_url;
+    root["compress_requests"] = config.compress_requests;
+    root["prompt_cache"] = config.prompt_cache;
+    root["exec_parallelism"] = config.exec_parallelism;
+    root["exec_output_bytes"] = config.exec_output_bytes;
+    root["exec_output_lines"] = config.exec_output_lines;
+    root["exec_log_retention"] = config.exec_log_retention;
+    root["exec_timeout"] = config.exec_timeout;
+    root["exec_cpu_seconds"] = config.exec_cpu_seconds;
+    root["exec_memory_mb"] = config.exec_memory_mb;
+    root["exec_max_output"] = config.exec_max_output;
+    root["exec_max_processes"] = config.exec_max_processes;
+    root["exec_persistent_shell"] = config.exec_persistent_shell;
+    root["backend"] = config.backend;
+    root["backends"] = Json::Value(Json::objectValue);
+    for (const auto& entry : config.backends) {
+        root["backends"][entry.first] = entry.second.toJson();
+    }
 
     Json::StreamWriterBuilder writer;
     return Json::writeString(writer, root);
 }
+
+ExecLimits execLimitsFrom(const Config& config) {
+    ExecLimits limits;
+    limits.timeout_s = std::max(0, config.exec_timeout);
+    limits.cpu_s = std::max(0, config.exec_cpu_seconds);
+    limits.memory_mb = std::max(0, config.exec_memory_mb);
+    limits.max_output = static_cast<unsigned long long>(std::max(0, config.exec_max_output));
+    limits.max_processes = std::max(0, config.exec_max_processes);
+    return limits;
+}
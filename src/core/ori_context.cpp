@@ -0,0 +1,156 @@
+#include "ori_context.h"
+#include <algorithm>
+
+namespace {
+// Tool outputs smaller than this are cheaper to keep than to describe.
+const size_t ELIDE_MIN_BYTES = 512;
+// Per-message cap on what goes into the summarizer's transcript.
+const size_t TRANSCRIPT_MESSAGE_BYTES = 4000;
+
+size_t firstMutable(const std::vector<ChatMessage>& history) {
+    return (!history.empty() && history[0].role == ChatRole::System) ? 1 : 0;
+}
+
+std::string elisionNote(const std::string& content) {
+    // Keep the first line: for command feedback it names the command
+    std::string first_line = content.substr(0, content.find('\n'));
+    if (first_line.size() > 200) {
+        first_line = first_line.substr(0, 200) + "...";
+    }
+    return "[Elided to fit the context window: " + std::to_string(content.size() / 1024 + 1) +
+           " KB of tool output from an earlier turn. It began: " + first_line + "]";
+}
+}
+
+size_t estimateTokens(const ChatMessage& msg) {
+    return (msg.content.size() * 2 + 6) / 7 + 4;
+}
+
+size_t estimateTokens(const std::vector<ChatMessage>& history) {
+    size_t total = 0;
+    for (const auto& msg : history) total += estimateTokens(msg);
+    return total;
+}
+
+ContextManager::~ContextManager() {
+    cancelled = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ContextManager::bumpGeneration() {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    summary_ready = false;
+}
+
+void ContextManager::historyRewritten() {
+    bumpGeneration();
+}
+
+size_t ContextManager::applyCompaction(std::vector<ChatMessage>& history) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!summary_ready) return history.size();
+    summary_ready = false;
+
+    size_t first = firstMutable(history);
+    if (summary_generation != generation || history.size() < first + summary_covers) {
+        return history.size();
+    }
+
+    history.erase(history.begin() + first, history.begin() + first + summary_covers);
+    history.insert(history.begin() + first,
+                   ChatMessage(ChatRole::User, "[Summary of the earlier conversation]\n" + summary));
+    summary.clear();
+    generation++;
+    return first;
+}
+
+size_t ContextManager::enforce(std::vector<ChatMessage>& history, const ContextPolicy& policy) {
+    if (policy.budget_tokens == 0) return history.size();
+    size_t total = estimateTokens(history);
+    if (total <= policy.budget_tokens) return history.size();
+
+    const size_t first = firstMutable(history);
+    const size_t protected_from = std::max(first,
+        history.size() > policy.keep_recent ? history.size() - policy.keep_recent : 0);
+    size_t changed = std::string::npos;
+
+    // Elide old tool outputs first: they are the bulk and the least useful later on
+    for (size_t i = first; i < protected_from && total > policy.budget_tokens; ++i) {
+        ChatMessage& msg = history[i];
+        if (!msg.tool_output || msg.content.size() <= ELIDE_MIN_BYTES) continue;
+        size_t before = estimateTokens(msg);
+        msg.content = elisionNote(msg.content);
+        msg.tool_output = false;
+        total -= before - estimateTokens(msg);
+        changed = std::min(changed, i);
+    }
+
+    // Then drop the oldest turns
+    size_t drop_end = first;
+    while (drop_end < protected_from && total > policy.budget_tokens) {
+        total -= estimateTokens(history[drop_end]);
+        drop_end++;
+    }
+    if (drop_end > first) {
+        size_t dropped = drop_end - first;
+        history.erase(history.begin() + first, history.begin() + drop_end);
+        history.insert(history.begin() + first, ChatMessage(ChatRole::User,
+            "[" + std::to_string(dropped) + " earlier messages were dropped to fit the context window]"));
+        changed = std::min(changed, first);
+    }
+
+    if (changed == std::string::npos) return history.size();
+    bumpGeneration();
+    return changed;
+}
+
+void ContextManager::maybeStartCompaction(const std::vector<ChatMessage>& history, const ContextPolicy& policy, Summarizer summarize) {
+    if (!policy.compact || policy.budget_tokens == 0 || !summarize) return;
+    if (estimateTokens(history) < policy.budget_tokens * COMPACT_THRESHOLD) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running || summary_ready) return;
+
+    const size_t first = firstMutable(history);
+    const size_t cut = history.size() > policy.keep_recent ? history.size() - policy.keep_recent : 0;
+    if (cut < first + 2) return; // nothing worth summarizing yet
+
+    // Copy the older turns out now; the worker must not touch the live history
+    std::string transcript;
+    for (size_t i = first; i < cut; ++i) {
+        const ChatMessage& msg = history[i];
+        transcript += "[";
+        transcript += chatRoleName(msg.role);
+        transcript += "]\n";
+        if (msg.content.size() > TRANSCRIPT_MESSAGE_BYTES) {
+            transcript.append(msg.content, 0, TRANSCRIPT_MESSAGE_BYTES);
+            transcript += "\n[...truncated...]";
+        } else {
+            transcript += msg.content;
+        }
+        transcript += "\n\n";
+    }
+
+    // The previous worker has finished (running is false), so this join is instant
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    running = true;
+    const unsigned long started_generation = generation;
+    const size_t covers = cut - first;
+    worker = std::thread([this, transcript, started_generation, covers, summarize]() {
+        std::string result = summarize(transcript, cancelled);
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        if (!result.empty() && started_generation == generation) {
+            summary = result;
+            summary_covers = covers;
+            summary_generation = started_generation;
+            summary_ready = true;
+        }
+    });
+}
@@ -1,4 +1,11 @@
 #include "ori_core.h"
+#include "ori_net.h"
+#include "ori_stats.h"
+#include "ori_metrics.h"
+#include "ori_protocol.h"
+#include "ori_cache.h"
+#include "ori_retry.h"
+#include "ori_exec.h"
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
@@ -14,8 +21,15 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <future>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <set>
 #include <csignal>
 #include <fcntl.h>
+#include <poll.h>
+#include <algorithm>
 #include <sys/wait.h>
 
 static std::atomic<bool> keep_running{true};
@@ -40,7 +54,10 @@ void run_spinner(const std::string& message) {
     while (keep_running) {
         std::cout << "\r" << frames[i] << " " << message << std::flush;
         i = (i + 1) % frames.size();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / fps));
+        // Sleep in short slices so stopping the spinner does not hold up the reply
+        for (int slept = 0; slept < 1000 / fps && keep_running; slept += 10) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
     }
     std::cout << "\r\x1b[2K\x1b[?25h";
 }
@@ -66,12 +83,422 @@ const std::string CYAN = "\033[36m";
 #include <curl/curl.h>
 #include <iomanip>
 
+
 // Callback function to write response data to a string
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* response) {
     size_t total_size = size * nmemb;
     response->append((char*)contents, total_size);
     return total_size;
 }
+
+// Transport errors worth retrying; they also count against the model's circuit breaker
+static bool isTransientCurlError(CURLcode code) {
+    return code == CURLE_COULDNT_CONNECT || code == CURLE_COULDNT_RESOLVE_HOST ||
+           code == CURLE_OPERATION_TIMEDOUT || code == CURLE_GOT_NOTHING ||
+           code == CURLE_SEND_ERROR || code == CURLE_RECV_ERROR;
+}
+
+// Bodies smaller than this go out as-is; gzip would not pay for itself
+static const size_t COMPRESS_MIN_BYTES = 4096;
+
+// Endpoints that refused a gzipped body; they get plain bodies from then on
+static std::mutex gzip_rejected_mutex;
+static std::set<std::string> gzip_rejected_urls;
+
+static bool gzipRejected(const std::string& url) {
+    std::lock_guard<std::mutex> lock(gzip_rejected_mutex);
+    return gzip_rejected_urls.count(url) > 0;
+}
+
+static void rejectGzip(const std::string& url) {
+    std::lock_guard<std::mutex> lock(gzip_rejected_mutex);
+    gzip_rejected_urls.insert(url);
+}
+
+// One request to one model. A hedged query races several of these and keeps
+// the reply of whichever answers first (when streaming: sends a token first).
+struct ChatLeg {
+    size_t index = 0;
+    std::string model;
+    const int* winner = nullptr; // index of the winning leg, -1 while undecided
+    CURL* curl = nullptr;
+    RequestBody body;
+    RequestBody wire_body; // gzipped copy of body, sent when the query compresses
+    std::string response_data;
+    std::unique_ptr<SseParser> parser; // streaming only
+    RetryHints hints;
+    bool started = false;
+    bool finished = false;
+    CURLcode result = CURLE_OK;
+    long http_code = 0;
+    unsigned long long received = 0; // decoded response bytes
+    std::chrono::steady_clock::time_point launched;
+    // First response byte, in microseconds since launch. Measured here
+    // because older libcurl stamps STARTTRANSFER when a POST starts uploading.
+    long long first_byte_us = 0;
+};
+
+// Callback function to collect a leg's response, feeding streamed (SSE) bodies
+// into its parser. Refusing the data aborts legs that lost the race.
+static size_t LegWriteCallback(void* contents, size_t size, size_t nmemb, ChatLeg* leg) {
+    if (*leg->winner >= 0 && *leg->winner != static_cast<int>(leg->index)) {
+        return 0;
+    }
+    size_t total_size = size * nmemb;
+    if (leg->received == 0) {
+        leg->first_byte_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - leg->launched).count();
+    }
+    leg->received += total_size;
+    if (leg->parser) {
+        leg->parser->feed((char*)contents, total_size);
+    } else {
+        leg->response_data.append((char*)contents, total_size);
+    }
+    return total_size;
+}
+
+// Transfer state of one sendQueryAsync() call: the legs racing for a reply,
+// the retry count and the hedge timer. Once started it is only touched from
+// the network loop thread, and it stays alive (through shared_ptr copies held
+// by pending callbacks) until the last of them has run.
+struct ChatQuery : std::enable_shared_from_this<ChatQuery> {
+    using StatusCallback = std::function<void(const std::string&)>;
+
+    bool streaming = false;
+    std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now();
+    std::string url;
+    std::string unix_socket; // set for backends reached over a Unix socket
+    long hedge_delay_ms = 0;
+    std::vector<std::unique_ptr<ChatLeg>> legs;
+    struct curl_slist* headers = nullptr;
+    struct curl_slist* gzip_headers = nullptr; // headers plus Content-Encoding: gzip
+    bool compressed = false;
+    bool gzip_probe = false; // resent plain after a 400; a success means the endpoint can't take gzip
+    StatusCallback on_status;
+    // Called once with this query when no more attempts will be made
+    std::function<void(ChatQuery&)> on_finished;
+
+    RetryPolicy retry_policy;
+    int attempt = 0;
+    int winner = -1;
+    bool first_token_seen = false;
+    size_t next_leg = 0;
+    size_t outcome = 0;   // the leg whose result is reported
+    size_t last_done = 0;
+    unsigned round = 0;   // bumped per attempt so stale hedge timers do nothing
+    bool done = false;
+    long primary_blocked_ms = 0;
+    std::string retry_reason;
+    std::string give_up_error;
+
+    ~ChatQuery() {
+        for (auto& leg : legs) {
+            if (leg->curl) ConnectionPool::instance().release(leg->curl);
+        }
+        curl_slist_free_all(headers);
+        curl_slist_free_all(gzip_headers);
+    }
+
+    void configureLeg(ChatLeg& leg) {
+        CURL* curl = leg.curl;
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        if (!unix_socket.empty()) {
+            curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, unix_socket.c_str());
+        }
+        RequestBody& upload = compressed ? leg.wire_body : leg.body;
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, compressed ? gzip_headers : headers);
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, RequestBody::read);
+        curl_easy_setopt(curl, CURLOPT_READDATA, &upload);
+        curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, RequestBody::seek);
+        curl_easy_setopt(curl, CURLOPT_SEEKDATA, &upload);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)upload.size());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, LegWriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &leg);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, RetryHints::headerCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &leg.hints);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "OriAssistant/1.0");
+        // A hedge must not queue behind the slow leg's connection; over HTTP/2 it
+        // still multiplexes onto it once that connection is established.
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, leg.index == 0 ? 1L : 0L);
+    }
+
+    // Feed a finished leg's outcome into its model's circuit breaker
+    static void recordHealth(const ChatLeg& leg) {
+        UpstreamHealth& health = UpstreamHealth::instance();
+        if (leg.result != CURLE_OK) {
+            health.record(leg.model, isTransientCurlError(leg.result) ? UpstreamHealth::Outcome::Failure
+                                                                      : UpstreamHealth::Outcome::Neutral,
+                          curl_easy_strerror(leg.result));
+        } else if (leg.http_code >= 500) {
+            health.record(leg.model, UpstreamHealth::Outcome::Failure, "HTTP " + std::to_string(leg.http_code));
+        } else if (leg.http_code == 429) {
+            health.record(leg.model, UpstreamHealth::Outcome::Neutral);
+        } else {
+            health.record(leg.model, UpstreamHealth::Outcome::Success);
+        }
+    }
+
+    // Add a leg's bytes to the wire-versus-logical counters
+    void countTransfer(const ChatLeg& leg) const {
+        curl_off_t uploaded = 0, downloaded = 0;
+        curl_easy_getinfo(leg.curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+        curl_easy_getinfo(leg.curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+        unsigned long long logical_up = static_cast<unsigned long long>(uploaded);
+        if (compressed && leg.wire_body.size() > 0) {
+            logical_up = logical_up * leg.body.size() / leg.wire_body.size();
+        }
+        TransferCounters& counters = TransferCounters::instance();
+        counters.addUpload(logical_up, static_cast<unsigned long long>(uploaded));
+        counters.addDownload(leg.received, static_cast<unsigned long long>(downloaded));
+    }
+
+    // Record where a finished (or cut off) leg's time went
+    void recordTiming(const ChatLeg& leg) const {
+        curl_off_t lookup = 0, connect = 0, tls = 0, pretransfer = 0, sent = 0, first_byte = 0, total = 0;
+        curl_off_t uploaded = 0, downloaded = 0;
+        long connects = 0;
+        curl_easy_getinfo(leg.curl, CURLINFO_NAMELOOKUP_TIME_T, &lookup);
+        curl_easy_getinfo(leg.curl, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(leg.curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+        curl_easy_getinfo(leg.curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+#if LIBCURL_VERSION_NUM >= 0x080a00
+        curl_easy_getinfo(leg.curl, CURLINFO_POSTTRANSFER_TIME_T, &sent);
+#endif
+        curl_easy_getinfo(leg.curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+        curl_easy_getinfo(leg.curl, CURLINFO_TOTAL_TIME_T, &total);
+        curl_easy_getinfo(leg.curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+        curl_easy_getinfo(leg.curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+        curl_easy_getinfo(leg.curl, CURLINFO_NUM_CONNECTS, &connects);
+
+        // Each mark is microseconds since the transfer began; a phase that did
+        // not happen (reused connection, no TLS, no reply) reads as zero.
+        connect = std::max(connect, lookup);
+        tls = tls > 0 ? std::max(tls, connect) : connect;
+        sent = std::max(sent > 0 ? sent : pretransfer, tls);
+        if (leg.first_byte_us > 0) first_byte = leg.first_byte_us;
+        first_byte = first_byte > 0 ? std::max(first_byte, sent) : std::max(total, sent);
+        total = std::max(total, first_byte);
+
+        TransferSample sample;
+        sample.model = leg.model;
+        sample.attempt = attempt;
+        sample.http_code = leg.http_code;
+        sample.curl_result = leg.result;
+        sample.used = winner == static_cast<int>(leg.index);
+        sample.new_connection = connects > 0;
+        sample.dns_ms = lookup / 1000.0;
+        sample.connect_ms = (connect - lookup) / 1000.0;
+        sample.tls_ms = (tls - connect) / 1000.0;
+        sample.send_ms = (sent - tls) / 1000.0;
+        sample.wait_ms = (first_byte - sent) / 1000.0;
+        sample.receive_ms = (total - first_byte) / 1000.0;
+        sample.total_ms = total / 1000.0;
+        sample.bytes_up = static_cast<unsigned long long>(uploaded);
+        sample.bytes_down = static_cast<unsigned long long>(downloaded);
+        UpstreamMetrics& metrics = upstreamMetrics().get(leg.model);
+        if (winner >= 0 && !sample.used) {
+            metrics.cancelled.fetch_add(1, std::memory_order_relaxed);
+        } else if (leg.result != CURLE_OK) {
+            metrics.transport_errors.fetch_add(1, std::memory_order_relaxed);
+        } else if (leg.http_code >= 400) {
+            metrics.http_errors.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            metrics.ok.fetch_add(1, std::memory_order_relaxed);
+        }
+        metrics.duration.observe(sample.total_ms / 1000.0);
+        if (leg.received > 0) metrics.first_byte.observe(sample.wait_ms / 1000.0);
+        RequestStats::instance().recordTransfer(std::move(sample));
+    }
+
+    void startAttempt() {
+        round++;
+        winner = -1;
+        next_leg = 0;
+        last_done = 0;
+        for (auto& leg : legs) {
+            leg->started = leg->finished = false;
+            leg->result = CURLE_OK;
+            leg->http_code = 0;
+            leg->received = 0;
+            leg->first_byte_us = 0;
+            leg->response_data.clear();
+            leg->body.rewind();
+            leg->wire_body.rewind();
+            leg->hints.reset();
+            if (leg->parser) leg->parser->reset();
+        }
+        if (!launchNext()) {
+            give_up_error = "Error: " + legs[0]->model + " is failing upstream; not retrying for another " +
+                            std::to_string((primary_blocked_ms + 999) / 1000) + "s";
+            finish();
+            return;
+        }
+        scheduleHedge();
+    }
+
+    // Start the next leg whose model's circuit breaker lets it through
+    bool launchNext() {
+        UpstreamHealth& health = UpstreamHealth::instance();
+        while (next_leg < legs.size()) {
+            ChatLeg& leg = *legs[next_leg++];
+            long blocked_ms = health.admit(leg.model);
+            if (blocked_ms > 0) {
+                if (leg.index == 0) primary_blocked_ms = blocked_ms;
+                continue;
+            }
+            if (!leg.curl && !(leg.curl = ConnectionPool::instance().acquire())) continue;
+            configureLeg(leg);
+            leg.started = true;
+            leg.launched = std::chrono::steady_clock::now();
+            if (leg.index > 0) health.recordHedge(false);
+            auto self = shared_from_this();
+            ChatLeg* leg_ptr = &leg;
+            NetworkLoop::instance().start(leg.curl, [self, leg_ptr](CURLcode result) {
+                self->legDone(*leg_ptr, result);
+            });
+            return true;
+        }
+        return false;
+    }
+
+    // Race the next fallback model if nothing has answered by then
+    void scheduleHedge() {
+        if (next_leg >= legs.size()) return;
+        auto self = shared_from_this();
+        unsigned scheduled_round = round;
+        NetworkLoop::instance().post([self, scheduled_round]() {
+            if (self->done || self->round != scheduled_round || self->winner >= 0) return;
+            if (self->launchNext()) self->scheduleHedge();
+        }, hedge_delay_ms);
+    }
+
+    // A streamed token picked a winner from inside a transfer callback, where
+    // handles cannot be removed; drop the losers from the loop afterwards.
+    void abortLosers() {
+        for (auto& leg : legs) {
+            if (!leg->started || leg->finished || static_cast<int>(leg->index) == winner) continue;
+            countTransfer(*leg);
+            recordTiming(*leg);
+            NetworkLoop::instance().abort(leg->curl);
+            leg->finished = true;
+            UpstreamHealth::instance().record(leg->model, UpstreamHealth::Outcome::Neutral);
+        }
+    }
+
+    void legDone(ChatLeg& leg, CURLcode result) {
+        leg.finished = true;
+        leg.result = result;
+        curl_easy_getinfo(leg.curl, CURLINFO_RESPONSE_CODE, &leg.http_code);
+        countTransfer(leg);
+        if (winner >= 0 && winner != static_cast<int>(leg.index)) {
+            // Cut off by the winner
+            recordTiming(leg);
+            UpstreamHealth::instance().record(leg.model, UpstreamHealth::Outcome::Neutral);
+            return;
+        }
+        recordHealth(leg);
+        last_done = leg.index;
+        if (winner < 0 && result == CURLE_OK && leg.http_code >= 200 && leg.http_code < 300) {
+            winner = static_cast<int>(leg.index);
+        }
+        recordTiming(leg);
+
+        if (winner >= 0) {
+            abortLosers();
+            attemptDone();
+            return;
+        }
+        for (auto& other : legs) {
+            if (other->started && !other->finished) return; // still racing
+        }
+        // Everything so far failed: go straight to the next model, if any
+        if (launchNext()) {
+            scheduleHedge();
+        } else {
+            attemptDone();
+        }
+    }
+
+    void attemptDone() {
+        outcome = winner >= 0 ? static_cast<size_t>(winner) : (legs[0]->started ? 0 : last_done);
+        const ChatLeg& result_leg = *legs[outcome];
+        const bool answered = result_leg.result == CURLE_OK;
+
+        if (gzip_probe) {
+            gzip_probe = false;
+            if (answered && result_leg.http_code >= 200 && result_leg.http_code < 300) rejectGzip(url);
+        }
+        // An endpoint that cannot read gzip bodies answers 415 (some just 400):
+        // resend the same request plain, without counting it as a retry.
+        if (compressed && winner < 0 && !first_token_seen && answered &&
+            (result_leg.http_code == 415 || result_leg.http_code == 400)) {
+            compressed = false;
+            if (result_leg.http_code == 415) {
+                rejectGzip(url);
+            } else {
+                gzip_probe = true;
+            }
+            auto self = shared_from_this();
+            NetworkLoop::instance().post([self]() { self->startAttempt(); });
+            return;
+        }
+
+        // Tokens already reached the caller; a retry would print them twice.
+        if (first_token_seen || winner >= 0 || attempt + 1 >= retry_policy.max_attempts) {
+            finish();
+            return;
+        }
+
+        long server_delay_ms = -1; // the pause the response asked for, if any
+        if (result_leg.result != CURLE_OK) {
+            if (!isTransientCurlError(result_leg.result)) {
+                finish();
+                return;
+            }
+            retry_reason = curl_easy_strerror(result_leg.result);
+        } else {
+            long http_code = result_leg.http_code;
+            bool retryable = http_code == 429 || http_code == 502 || http_code == 503 || http_code == 504;
+            server_delay_ms = result_leg.hints.delayFor(http_code);
+            // A server asking for a longer pause than is worth waiting out ends the retries
+            if (!retryable || server_delay_ms > retry_policy.max_retry_after_ms) {
+                finish();
+                return;
+            }
+            retry_reason = http_code == 429 ? "rate limited" : "upstream unavailable (HTTP " + std::to_string(http_code) + ")";
+        }
+
+        attempt++;
+        upstreamMetrics().get(legs[0]->model).retries.fetch_add(1, std::memory_order_relaxed);
+        long delay_ms = backoffDelayMs(attempt, retry_policy, server_delay_ms);
+        UpstreamHealth::instance().recordRetry(legs[0]->model, retry_reason, delay_ms);
+        if (on_status) {
+            std::ostringstream message;
+            message << retry_reason << ", retrying in " << (delay_ms + 500) / 1000 << "s...";
+            on_status(message.str());
+        }
+        auto self = shared_from_this();
+        NetworkLoop::instance().post([self]() { self->startAttempt(); }, delay_ms);
+    }
+
+    void finish() {
+        if (done) return;
+        done = true;
+        if (winner > 0) {
+            UpstreamHealth::instance().recordHedge(true);
+        }
+        if (on_finished) on_finished(*this);
+        // A pending hedge timer can keep this object alive for a while; hand the
+        // handles back and let go of the callback's state (the cache flight) now.
+        on_finished = nullptr;
+        for (auto& leg : legs) {
+            if (leg->curl) ConnectionPool::instance().release(leg->curl);
+            leg->curl = nullptr;
+        }
+    }
+};
 #endif
 #include <json/json.h>
 #include <dirent.h>
@@ -163,6 +590,19 @@ std::string OriAssistant::readInput() {
     refresh();
 
     while (true) {
+        // Wait for a key; an update check that finishes meanwhile gets its
+        // notice printed above the prompt, which is then redrawn.
+        struct pollfd stdin_poll = {STDIN_FILENO, POLLIN, 0};
+        while (poll(&stdin_poll, 1, 250) == 0) {
+            if (!update_checker.noticePending()) continue;
+            size_t lines_above = std::count(buffer.begin(), buffer.begin() + cursor, '\n');
+            if (lines_above > 0) printf("\033[%zuA", lines_above);
+            printf("\r\033[J");
+            fflush(stdout);
+            showUpdateNotice("\r\n");
+            refresh();
+        }
+
         char c = 0;
         if (read(STDIN_FILENO, &c, 1) <= 0) {
             tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
@@ -299,12 +739,24 @@ std::string OriAssistant::readInput() {
 OpenRouterAPI::OpenRouterAPI() {
     // Constructor
     model = "google/gemini-2.0-flash-exp:free";
+    setBackend(BackendProfile::openRouter());
+}
+
+void OpenRouterAPI::setBackend(const BackendProfile& profile) {
+    backend = profile;
+    // ORI_API_URL beats the config file so any install can be pointed at a mock server
+    const char* env_url = std::getenv("ORI_API_URL");
+    api_url = (env_url != nullptr && env_url[0] != '\0') ? env_url : backend.chatUrl();
 }
 
 OpenRouterAPI::~OpenRouterAPI() {
     // Destructor
 }
 
+void OpenRouterAPI::setCompressRequests(bool enabled) {
+    compress_requests = enabled;
+}
+
 void OpenRouterAPI::setModel(const std::string& model_name) {
     model = model_name;
 }
@@ -371,10 +823,63 @@ void OpenRouterAPI::setSystemPrompt(const std::string& prompt) {
     // Directly set the system prompt provided by the caller. The prompt should
     // be a plain-text instruction (no external file loading).
     conversation_history.clear();
-    conversation_history.push_back({"system", prompt});
+    history_serializer.invalidateFrom(0);
+    context_manager.historyRewritten();
+    conversation_history.emplace_back(ChatRole::System, prompt);
+    // The system prompt is the same multi-KB prefix on every turn
+    conversation_history.back().cache_breakpoint = true;
+}
+
+void OpenRouterAPI::setContextConfig(const Config& config) {
+    default_context_budget = config.context_budget;
+    context_budgets = config.context_budgets;
+    context_policy.keep_recent = config.context_keep_recent > 0 ? config.context_keep_recent : 0;
+    context_policy.compact = config.context_compact;
+    prompt_cache = config.prompt_cache;
+}
+
+void OpenRouterAPI::setHedgeConfig(const Config& config) {
+    hedge_models.clear();
+    std::stringstream list(config.hedge_models);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (!name.empty()) hedge_models.push_back(name);
+    }
+    hedge_delay_ms = config.hedge_delay_ms > 0 ? config.hedge_delay_ms : 0;
+}
+
+ContextPolicy OpenRouterAPI::currentContextPolicy() const {
+    // The model can change between turns (GUI model picker), so resolve per request
+    ContextPolicy policy = context_policy;
+    auto it = context_budgets.find(model);
+    int budget = (it != context_budgets.end()) ? it->second : default_context_budget;
+    policy.budget_tokens = budget > 0 ? static_cast<size_t>(budget) : 0;
+    return policy;
+}
+
+void OpenRouterAPI::addContext(const std::string& text, bool pinned) {
+    size_t breakpoints = 0;
+    for (const auto& msg : conversation_history) {
+        if (msg.cache_breakpoint) breakpoints++;
+    }
+    conversation_history.emplace_back(ChatRole::User, text, true);
+    conversation_history.back().cache_breakpoint = pinned && breakpoints < MAX_CACHE_BREAKPOINTS;
 }
 
 bool OpenRouterAPI::loadApiKey() {
+    // Other servers take their key from their profile, if they want one at all
+    if (!backend.needsKey()) {
+        api_key.clear();
+        return true;
+    }
+    if (!backend.configuredKey().empty()) {
+        api_key = backend.configuredKey();
+        return true;
+    }
+    if (!backend.isOpenRouter()) return false;
+
     // Try environment variable first
     const char* env_key = std::getenv("OPENROUTER_API_KEY");
     if (env_key != nullptr && std::strlen(env_key) > 0) {
@@ -438,195 +943,528 @@ std::string OpenRouterAPI::colorize(const std::string& color, const std::string&
     return color + text + RESET;
 }
 
-std::string OpenRouterAPI::sendQuery(const std::string& prompt) {
+void OpenRouterAPI::prewarmConnection() {
 #ifdef CURL_FOUND
-    // Add user's message to history
-    conversation_history.push_back({"user", prompt});
+    ConnectionPool::instance().prewarm(api_url, backend.unix_socket);
+#endif
+}
 
-    // Initialize curl
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        return colorize(RED, "Error: Failed to initialize curl");
+// Build a readable message from an OpenRouter {"error": {...}} object
+static std::string describeApiError(const Json::Value& error_obj) {
+    std::string error_message = "API Error";
+    if (error_obj.isMember("code") && error_obj["code"].isNumeric()) {
+        error_message += " (Code: " + error_obj["code"].asString() + ")";
     }
-    
-    // Prepare the request data
-    Json::Value request_data;
-    request_data["model"] = model;
-    
-    Json::Value messages(Json::arrayValue);
-    for (const auto& msg : conversation_history) {
-        Json::Value message;
-        message["role"] = msg.role;
-        message["content"] = msg.content;
-        messages.append(message);
+    if (error_obj.isMember("message") && error_obj["message"].isString()) {
+        error_message += ": " + error_obj["message"].asString();
     }
-    request_data["messages"] = messages;
-    
-    Json::StreamWriterBuilder builder;
-    builder["indentation"] = ""; // Compact output
-    std::string json_data = Json::writeString(builder, request_data);
-
-    // Debug: optionally print the outgoing JSON payload so we can verify the system prompt
-    const char* debug_env = std::getenv("ORI_DEBUG");
-    if (debug_env && std::string(debug_env) == "1") {
-        std::cerr << "[ORI_DEBUG] Outgoing JSON payload:\n" << json_data << std::endl;
-        std::cerr << "[ORI_DEBUG] conversation_history roles: ";
-        for (const auto& msg : conversation_history) std::cerr << msg.role << ",";
-        std::cerr << std::endl;
+    if (error_obj.isMember("metadata") && error_obj["metadata"].isObject() &&
+        error_obj["metadata"].isMember("raw") && error_obj["metadata"]["raw"].isString()) {
+        error_message += " (Details: " + error_obj["metadata"]["raw"].asString() + ")";
     }
-    
-    // Set up curl options
-    std::string response_data;
+    return error_message;
+}
+
+#ifdef CURL_FOUND
+// Progress callback that aborts a transfer once the flag it points to is set
+static int CancelProgressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return static_cast<const std::atomic<bool>*>(clientp)->load() ? 1 : 0;
+}
+#endif
+
+std::string OpenRouterAPI::completeOnce(const BackendProfile& backend, const std::string& url, const std::string& key,
+                                        const std::string& model_name, const std::string& system_prompt, const std::string& user_prompt,
+                                        const std::atomic<bool>& cancelled) {
+#ifdef CURL_FOUND
+    ConnectionPool& pool = ConnectionPool::instance();
+    CURL* curl = pool.acquire();
+    if (!curl) return "";
+
+    std::string body = "{\"model\":";
+    appendJsonString(body, backend.mapModel(model_name));
+    body += ",\"messages\":[{\"role\":\"system\",\"content\":";
+    appendJsonString(body, system_prompt);
+    body += "},{\"role\":\"user\",\"content\":";
+    appendJsonString(body, user_prompt);
+    body += "}]}";
+
     struct curl_slist* headers = NULL;
-    
     headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string auth_header = "Authorization: Bearer " + api_key;
-    headers = curl_slist_append(headers, auth_header.c_str());
-    
-    curl_easy_setopt(curl, CURLOPT_URL, "https://openrouter.ai/api/v1/chat/completions");
+    for (const auto& line : backend.requestHeaders(key)) {
+        headers = curl_slist_append(headers, line.c_str());
+    }
+
+    std::string response_data;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    if (!backend.unix_socket.empty()) {
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, backend.unix_socket.c_str());
+    }
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body.size());
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "OriAssistant/1.0");
-    
-    // Perform the request with retry logic
-    const int max_retries = 5;
-    const int retry_delay_seconds = 2;
-    CURLcode res = CURLE_OK;
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelProgressCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, const_cast<std::atomic<bool>*>(&cancelled));
+    CURLcode res = curl_easy_perform(curl);
     long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_slist_free_all(headers);
+    pool.release(curl);
 
-    for (int attempt = 0; attempt < max_retries; ++attempt) {
-        std::string spinner_message = "loading...";
-        if (attempt > 0) {
-            std::string reason;
-            if (res != CURLE_OK) {
-                reason = curl_easy_strerror(res);
-            } else if (http_code == 429) {
-                reason = "rate limited";
-            } else {
-                reason = "connection failed";
-            }
-            spinner_message = reason + ", retrying...";
-            std::this_thread::sleep_for(std::chrono::seconds(retry_delay_seconds));
-        }
+    if (res != CURLE_OK || http_code < 200 || http_code >= 300) return "";
+    Json::Value response_json;
+    Json::Reader reader;
+    if (!reader.parse(response_data, response_json)) return "";
+    const Json::Value& choices = response_json["choices"];
+    if (!choices.isArray() || choices.empty()) return "";
+    return choices[0]["message"]["content"].asString();
+#else
+    (void)key; (void)model_name; (void)system_prompt; (void)user_prompt; (void)cancelled;
+    return "";
+#endif
+}
 
-        response_data.clear();
-        keep_running = true;
-        std::thread spinner_thread(run_spinner, spinner_message);
-        res = curl_easy_perform(curl);
+std::string OpenRouterAPI::sendQuery(const std::string& prompt, const TokenCallback& on_token, bool tool_output) {
+#ifdef CURL_FOUND
+    // The spinner runs until the reply is complete or, when streaming, until
+    // the first token arrives and the caller starts printing. The network
+    // thread only queues what it gets; tokens, retry notices and the reply are
+    // handled here, so a slow terminal or browser (on_token writes to it) and
+    // the spinner join never hold up the other transfers on that thread.
+    std::thread spinner_thread;
+    auto stop_spinner = [&spinner_thread]() {
         keep_running = false;
-        spinner_thread.join();
+        if (spinner_thread.joinable()) spinner_thread.join();
+    };
+    auto start_spinner = [&spinner_thread, this](const std::string& message) {
+        if (m_isGui) return; // GUI requests run concurrently; there is no terminal to draw on
+        keep_running = true;
+        spinner_thread = std::thread(run_spinner, message);
+    };
 
-        if (res != CURLE_OK) {
-            if (res == CURLE_COULDNT_CONNECT || res == CURLE_COULDNT_RESOLVE_HOST || res == CURLE_OPERATION_TIMEDOUT) {
-                if (attempt < max_retries - 1) continue; // Retry on specific connection errors
+    enum class EventKind { Token, Status, Done };
+    struct Events {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::pair<EventKind, std::string>> queue;
+        void push(EventKind kind, const std::string& text) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.emplace_back(kind, text);
             }
-            break; // Don't retry on other curl errors or on last attempt
-        }
-
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-
-        if (http_code >= 200 && http_code < 300) {
-            break; // Success
-        }
-
-        if (http_code == 429) { // Rate limit
-            if (attempt < max_retries - 1) continue; // Retry
+            ready.notify_one();
         }
+    };
+    // Shared with the callbacks, which the network thread may release after we return
+    auto events = std::make_shared<Events>();
 
-        // For any other http_code, break and fail.
-        break;
-    }
-    
-    // Clean up
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-    
-    if (res != CURLE_OK) {
-        return colorize(RED, "Error: Failed to connect to OpenRouter API - " + std::string(curl_easy_strerror(res)));
+    TokenCallback token_wrapper;
+    if (on_token) {
+        token_wrapper = [events](const std::string& delta) { events->push(EventKind::Token, delta); };
     }
-    
-    // Parse the response
-    Json::Value response_json;
-    Json::Reader reader;
-    if (!reader.parse(response_data, response_json)) {
-        return colorize(RED, "Error: Failed to parse API response - " + response_data);
-    }
-    
-    // Check for a structured error response
-    if (response_json.isMember("error")) {
-        std::string error_message = "API Error";
-        const Json::Value& error_obj = response_json["error"];
-
-        if (error_obj.isMember("code") && error_obj["code"].isNumeric()) {
-            error_message += " (Code: " + error_obj["code"].asString() + ")";
-        }
-        if (error_obj.isMember("message") && error_obj["message"].isString()) {
-            error_message += ": " + error_obj["message"].asString();
+    start_spinner("loading...");
+    sendQueryAsync(prompt, token_wrapper,
+        [events](const std::string& text) { events->push(EventKind::Done, text); },
+        tool_output,
+        [events](const std::string& status) { events->push(EventKind::Status, status); });
+
+    bool first_token_seen = false;
+    std::string result;
+    std::unique_lock<std::mutex> lock(events->mutex);
+    while (true) {
+        events->ready.wait(lock, [&events]() { return !events->queue.empty(); });
+        std::pair<EventKind, std::string> event = std::move(events->queue.front());
+        events->queue.pop_front();
+        lock.unlock();
+        if (event.first == EventKind::Done) {
+            result = std::move(event.second);
+            break;
         }
-        if (error_obj.isMember("metadata") && error_obj["metadata"].isObject() &&
-            error_obj["metadata"].isMember("raw") && error_obj["metadata"]["raw"].isString()) {
-            error_message += " (Details: " + error_obj["metadata"]["raw"].asString() + ")";
+        if (event.first == EventKind::Status) {
+            stop_spinner();
+            start_spinner(event.second);
+        } else {
+            if (!first_token_seen) {
+                first_token_seen = true;
+                stop_spinner();
+            }
+            on_token(event.second);
         }
-        return colorize(RED, error_message);
-    }
-    
-    // Extract the response text
-    if (response_json.isMember("choices") && response_json["choices"].isArray() && 
-        response_json["choices"].size() > 0 && 
-        response_json["choices"][0].isMember("message") && 
-        response_json["choices"][0]["message"].isMember("content")) {
-        
-        std::string assistant_response = response_json["choices"][0]["message"]["content"].asString();
-        // Add assistant's response to history
-        conversation_history.push_back({"assistant", assistant_response});
-        return assistant_response;
-    } else {
-        return colorize(RED, "Error: Unexpected API response format - " + response_data);
+        lock.lock();
     }
+    stop_spinner();
+    return result;
 #else
     // Fallback to a local stub that at least includes the system prompt and conversation
     // so that the system prompt is not ignored when libcurl is unavailable.
     std::ostringstream oss;
     oss << "[LocalStub] Conversation so far:\n\n";
     for (const auto& msg : conversation_history) {
-        oss << "[" << msg.role << "]\n" << msg.content << "\n\n";
+        oss << "[" << chatRoleName(msg.role) << "]\n" << msg.content << "\n\n";
     }
     oss << "[user]\n" << prompt << "\n\n";
     oss << "[assistant]\n";
     // This is a stub response — in a full build with libcurl this would be the model output.
     oss << "(no model available in this build; install libcurl and enable CURL_FOUND to contact the API)";
     // Add assistant's response to history so subsequent calls see context
-    conversation_history.push_back({"assistant", oss.str()});
+    conversation_history.emplace_back(ChatRole::Assistant, oss.str());
+    if (on_token) {
+        on_token(oss.str());
+    }
     return oss.str();
 #endif
 }
 
+void OpenRouterAPI::sendQueryAsync(const std::string& prompt, TokenCallback on_token, DoneCallback on_done,
+                                   bool tool_output, StatusCallback on_status) {
+#ifdef CURL_FOUND
+    const bool streaming = static_cast<bool>(on_token);
 
+    // Add user's message to history
+    conversation_history.emplace_back(ChatRole::User, prompt, tool_output);
+
+    // Keep the request inside the model's context window: swap in a finished
+    // background summary, trim what is still over budget, and start a new
+    // summary of older turns if we are getting close.
+    ContextPolicy policy = currentContextPolicy();
+    size_t changed = context_manager.applyCompaction(conversation_history);
+    changed = std::min(changed, context_manager.enforce(conversation_history, policy));
+    history_serializer.invalidateFrom(changed);
+    BackendProfile backend_copy = backend;
+    std::string url_copy = api_url;
+    std::string key_copy = api_key;
+    std::string model_copy = model;
+    context_manager.maybeStartCompaction(conversation_history, policy,
+        [backend_copy, url_copy, key_copy, model_copy](const std::string& transcript, const std::atomic<bool>& cancelled) {
+            return completeOnce(backend_copy, url_copy, key_copy, model_copy,
+                "You compress chat transcripts. Summarize the conversation below between a user and a "
+                "terminal assistant that runs shell commands. Keep every fact, file name, path, command "
+                "and result the assistant may need to continue the task. Be concise; use bullet points.",
+                transcript, cancelled);
+        });
+
+    // Prepare the request data. Messages serialized on earlier turns are
+    // reused as-is; only the ones added since then are escaped now.
+    history_serializer.sync(conversation_history, prompt_cache && modelTakesCacheHints(backend.mapModel(model)));
+    // Streams only carry token counts (and so cache hits) when asked to
+    const char* const body_tail = streaming ? ",\"stream\":true,\"stream_options\":{\"include_usage\":true}}" : "}";
+    auto build_body = [this](RequestBody& body, const std::string& model_name) {
+        std::string body_head = "{\"model\":";
+        appendJsonString(body_head, backend.mapModel(model_name));
+        body_head += ",\"messages\":[";
+        body.append(std::move(body_head));
+        history_serializer.appendTo(body);
+        body.append("]");
+    };
+    RequestBody request_body;
+    build_body(request_body, model);
+
+    // The cache key covers model, messages and generation parameters, but not
+    // whether the reply is streamed, so streamed and plain calls share entries.
+    ResponseCache& cache = ResponseCache::instance();
+    std::string cache_key;
+    if (cache.enabled()) {
+        cache_key = ResponseCache::keyFor(request_body);
+    }
+    request_body.append(body_tail);
+
+    // Reports the outcome to requests waiting on the same cache key once the query is gone
+    struct CacheFlight {
+        ResponseCache* cache = nullptr;
+        std::string key;
+        bool ok = false;
+        std::string reply;
+        ~CacheFlight() { if (cache) cache->complete(key, ok, reply); }
+    };
+    auto cache_flight = std::make_shared<CacheFlight>();
 
-#ifdef CURL_FOUND
-static bool curl_initialized = false;
-#endif
+    // Debug: optionally print the outgoing JSON payload so we can verify the system prompt
+    const char* debug_env = std::getenv("ORI_DEBUG");
+    if (debug_env && std::string(debug_env) == "1") {
+        std::cerr << "[ORI_DEBUG] Outgoing JSON payload:\n" << request_body.str() << std::endl;
+        std::cerr << "[ORI_DEBUG] conversation_history roles: ";
+        for (const auto& msg : conversation_history) std::cerr << chatRoleName(msg.role) << ",";
+        std::cerr << std::endl;
+    }
 
-OriAssistant::OriAssistant() {
-#ifdef CURL_FOUND
-    if (!curl_initialized) {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl_initialized = true;
+    auto query = std::make_shared<ChatQuery>();
+    query->streaming = streaming;
+    query->url = api_url;
+    query->unix_socket = backend.unix_socket;
+    query->hedge_delay_ms = hedge_delay_ms;
+    query->on_status = std::move(on_status);
+
+    // The primary model goes first; each fallback model joins the race once
+    // the legs before it have gone hedge_delay_ms without an answer.
+    std::weak_ptr<ChatQuery> weak_query = query;
+    auto add_leg = [&](const std::string& leg_model, RequestBody body) {
+        std::unique_ptr<ChatLeg> leg(new ChatLeg());
+        leg->index = query->legs.size();
+        leg->model = leg_model;
+        leg->winner = &query->winner;
+        leg->body = std::move(body);
+        if (streaming) {
+            const int index = static_cast<int>(leg->index);
+            ChatQuery* q = query.get();
+            leg->parser.reset(new SseParser([q, weak_query, index, on_token](const std::string& delta) {
+                if (q->winner < 0) {
+                    // The first token decides the race
+                    q->winner = index;
+                    NetworkLoop::instance().post([weak_query]() {
+                        if (auto self = weak_query.lock()) {
+                            if (!self->done) self->abortLosers();
+                        }
+                    });
+                }
+                if (q->winner != index) return;
+                q->first_token_seen = true;
+                on_token(delta);
+            }));
+        }
+        query->legs.push_back(std::move(leg));
+    };
+    add_leg(model, std::move(request_body));
+    for (const auto& fallback : hedge_models) {
+        if (fallback == model) continue;
+        RequestBody body;
+        build_body(body, fallback);
+        body.append(body_tail);
+        add_leg(fallback, std::move(body));
     }
+
+    // Set up curl options
+    const std::vector<std::string> backend_headers = backend.requestHeaders(api_key);
+    auto request_headers = [streaming, backend_headers](struct curl_slist* list) {
+        list = curl_slist_append(list, "Content-Type: application/json");
+        // Large bodies would otherwise wait for a 100-continue round trip
+        list = curl_slist_append(list, "Expect:");
+        if (streaming) {
+            list = curl_slist_append(list, "Accept: text/event-stream");
+        }
+        for (const auto& line : backend_headers) {
+            list = curl_slist_append(list, line.c_str());
+        }
+        return list;
+    };
+    query->headers = request_headers(nullptr);
+
+    // Runs on the network thread once the query is over: turn the winning
+    // leg's response into the reply and record it in the history.
+    query->on_finished = [this, streaming, on_token, on_done, cache_flight](ChatQuery& finished) {
+        ChatLeg& result_leg = *finished.legs[finished.outcome];
+        last_stats = QueryStats();
+        last_stats.model = result_leg.model;
+        last_stats.retries = finished.attempt;
+        auto record = [this, &finished]() {
+            QuerySample sample;
+            sample.model = last_stats.model;
+            sample.ok = last_stats.ok;
+            sample.retries = last_stats.retries;
+            sample.total_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - finished.created).count();
+            sample.prompt_tokens = last_stats.prompt_tokens;
+            sample.cached_tokens = last_stats.cached_prompt_tokens;
+            if (last_stats.usage.isObject()) {
+                sample.completion_tokens = last_stats.usage.get("completion_tokens",
+                    last_stats.usage.get("output_tokens", -1)).asInt64();
+            }
+            UpstreamMetrics& metrics = upstreamMetrics().get(sample.model);
+            if (sample.prompt_tokens > 0) metrics.prompt_tokens.fetch_add(sample.prompt_tokens, std::memory_order_relaxed);
+            if (sample.completion_tokens > 0) {
+                metrics.completion_tokens.fetch_add(sample.completion_tokens, std::memory_order_relaxed);
+            }
+            metrics.cached_tokens.fetch_add(sample.cached_tokens, std::memory_order_relaxed);
+            RequestStats::instance().recordQuery(std::move(sample));
+        };
+        auto reply = [this, &on_done, &record](const std::string& text) {
+            last_stats.ok = true;
+            if (promptTokenUsage(last_stats.usage, last_stats.prompt_tokens, last_stats.cached_prompt_tokens)) {
+                PromptCacheCounters::instance().add(last_stats.prompt_tokens, last_stats.cached_prompt_tokens);
+                const char* debug_env = std::getenv("ORI_DEBUG");
+                if (debug_env && std::string(debug_env) == "1") {
+                    std::cerr << "[ORI_DEBUG] Prompt tokens: " << last_stats.prompt_tokens << ", "
+                              << last_stats.cached_prompt_tokens << " cached" << std::endl;
+                }
+            }
+            record();
+            if (on_done) on_done(text);
+        };
+        auto fail = [this, &on_done, &record](const std::string& message) {
+            last_stats.error = message;
+            record();
+            if (on_done) on_done(colorize(RED, message));
+        };
+        if (!finished.give_up_error.empty()) {
+            fail(finished.give_up_error);
+            return;
+        }
+
+        if (result_leg.result != CURLE_OK && !finished.first_token_seen) {
+            std::string target = backend.isOpenRouter() ? "OpenRouter API" : "backend \"" + backend.name + "\"";
+            fail("Error: Failed to connect to " + target + " - " + std::string(curl_easy_strerror(result_leg.result)));
+            return;
+        }
+
+        std::string response_data = std::move(result_leg.response_data);
+        const SseParser* sse_parser = result_leg.parser.get();
+        if (streaming && sse_parser->sawEvents()) {
+            if (!sse_parser->error().isNull()) {
+                fail(describeApiError(sse_parser->error()));
+                return;
+            }
+            last_stats.usage = sse_parser->usage();
+            // Keep whatever arrived even if the stream was cut short, so the
+            // history matches what the user already saw on screen.
+            std::string assistant_response = sse_parser->text();
+            conversation_history.emplace_back(ChatRole::Assistant, assistant_response);
+            if (sse_parser->finished()) {
+                cache_flight->ok = true;
+                cache_flight->reply = assistant_response;
+            }
+            reply(assistant_response);
+            return;
+        }
+        if (streaming) {
+            // No events: the server answered with a plain JSON body instead
+            response_data = sse_parser->raw();
+        }
+        
+        // Parse the response
+        Json::Value response_json;
+        Json::Reader reader;
+        if (!reader.parse(response_data, response_json)) {
+            fail("Error: Failed to parse API response - " + response_data);
+            return;
+        }
+        
+        // Check for a structured error response
+        if (response_json.isMember("error")) {
+            fail(describeApiError(response_json["error"]));
+            return;
+        }
+        
+        // Extract the response text
+        if (response_json.isMember("choices") && response_json["choices"].isArray() && 
+            response_json["choices"].size() > 0 && 
+            response_json["choices"][0].isMember("message") && 
+            response_json["choices"][0]["message"].isMember("content")) {
+            
+            std::string assistant_response = response_json["choices"][0]["message"]["content"].asString();
+            last_stats.usage = response_json.get("usage", Json::Value());
+            // Add assistant's response to history
+            conversation_history.emplace_back(ChatRole::Assistant, assistant_response);
+            cache_flight->ok = true;
+            cache_flight->reply = assistant_response;
+            if (streaming) {
+                on_token(assistant_response);
+            }
+            reply(assistant_response);
+        } else {
+            fail("Error: Unexpected API response format - " + response_data);
+        }
+    };
+
+    // Sends the query. It may run on the network thread, when an identical
+    // request this one waited on failed, so it only touches the query.
+    const bool compress = compress_requests;
+    const std::string url_for_gzip = api_url;
+    auto launch = [this, query, on_done, compress, url_for_gzip, request_headers]() {
+        // Borrow a pooled handle so DNS, TCP and TLS state carry over from the last turn
+        query->legs[0]->curl = ConnectionPool::instance().acquire();
+        if (!query->legs[0]->curl) {
+            last_stats = QueryStats();
+            last_stats.error = "Error: Failed to initialize curl";
+            if (on_done) on_done(colorize(RED, last_stats.error));
+            return;
+        }
+
+        // Large bodies go out gzipped when enabled, unless this endpoint refused that before
+        if (compress && query->legs[0]->body.size() >= COMPRESS_MIN_BYTES && !gzipRejected(url_for_gzip)) {
+            query->compressed = true;
+            for (auto& leg : query->legs) {
+                query->compressed = query->compressed && gzipRequestBody(leg->body, leg->wire_body);
+            }
+        }
+        if (query->compressed) {
+            query->gzip_headers = curl_slist_append(request_headers(nullptr), "Content-Encoding: gzip");
+        }
+        NetworkLoop::instance().post([query]() { query->startAttempt(); });
+    };
+    if (cache_key.empty()) {
+        launch();
+        return;
+    }
+
+    // A reply from the cache or from an identical request, in place of a transfer
+    auto deliver = [this, streaming, on_token, on_done, model_copy](const std::string& cached_reply) {
+        last_stats = QueryStats();
+        last_stats.ok = true;
+        last_stats.model = model_copy;
+        last_stats.cached = true;
+        conversation_history.emplace_back(ChatRole::Assistant, cached_reply);
+        if (streaming) {
+            on_token(cached_reply);
+        }
+        if (on_done) on_done(cached_reply);
+    };
+    // Registered with the cache while an identical request is in flight, so
+    // this call never blocks on it; once that one fails we try again.
+    struct CacheWaiter {
+        std::string key;
+        std::function<void(const std::string&)> deliver;
+        std::function<void()> launch;
+        std::shared_ptr<CacheFlight> flight;
+
+        void operator()(bool ok, const std::string& reply) const {
+            if (ok) {
+                deliver(reply);
+            } else {
+                start();
+            }
+        }
+        // Answer from the cache, send the request as the one in flight for
+        // the key, or wait for the identical one already sent
+        void start() const {
+            ResponseCache& cache = ResponseCache::instance();
+            std::string cached_reply;
+            switch (cache.acquire(key, cached_reply, *this)) {
+            case ResponseCache::Lookup::Hit:
+                deliver(cached_reply);
+                break;
+            case ResponseCache::Lookup::Miss:
+                flight->cache = &cache;
+                flight->key = key;
+                launch();
+                break;
+            case ResponseCache::Lookup::Joined:
+                break;
+            }
+        }
+    };
+    CacheWaiter{cache_key, deliver, launch, cache_flight}.start();
+#else
+    (void)on_status;
+    std::string reply = sendQuery(prompt, on_token, tool_output);
+    if (on_done) on_done(reply);
 #endif
+}
+
+
+
+OriAssistant::OriAssistant() {
+    // Kept cheap on purpose: libcurl is initialized by ConnectionPool on the
+    // first request, so paths that never touch the network never pay for it.
     api = std::make_unique<OpenRouterAPI>();
 }
 
 OriAssistant::~OriAssistant() {
     // Destructor
-#ifdef CURL_FOUND
-    curl_global_cleanup();
-#endif
 }
 
-bool OriAssistant::initialize() {
+bool OriAssistant::initialize(const std::function<void(Config&)>& adjust_config) {
     std::signal(SIGINT, sigint_handler);
     // Create config directory if it doesn't exist
     const char* home_dir = std::getenv("HOME");
@@ -639,16 +1477,40 @@ bool OriAssistant::initialize() {
     }
     
     configManager.loadConfig(config);
+    if (adjust_config) {
+        adjust_config(config);
+    }
     api->setModel(config.model);
+    api->setContextConfig(config);
+    api->setHedgeConfig(config);
+    BackendProfile backend;
+    std::string backend_error;
+    if (!resolveBackend(config.backend, config.backends, config.api_url, backend, backend_error)) {
+        std::cerr << RED << backend_error << RESET << std::endl;
+        return false;
+    }
+    api->setBackend(backend);
+    api->setCompressRequests(config.compress_requests);
+
+    std::string cache_dir;
+    if (home_dir != nullptr) {
+        cache_dir = std::string(home_dir) + "/.config/ori/cache";
+    }
+    ResponseCache::instance().configure(config.cache, config.cache_ttl, config.cache_entries, cache_dir);
 
     if (!api->loadApiKey()) {
-        std::cerr << RED << "Error: Failed to load API key. Please set OPENROUTER_API_KEY or create Openrouter_api_key.txt." << RESET << std::endl;
+        if (backend.isOpenRouter()) {
+            std::cerr << RED << "Error: Failed to load API key. Please set OPENROUTER_API_KEY or create Openrouter_api_key.txt." << RESET << std::endl;
+        } else {
+            std::cerr << RED << "Error: backend \"" << backend.name << "\" has no API key; set its api_key or api_key_env, or auth \"none\"" << RESET << std::endl;
+        }
         return false;
     }
     return true;
 }
 
 void OriAssistant::run() {
+    // Returns at once; the notice appears at the prompt whenever the check finishes
     checkForUpdates(true);
     if (!config.no_clear) {
         // Clear screen before showing banner
@@ -664,6 +1526,11 @@ void OriAssistant::run() {
     printf("\033[s");
     
     while (true) {
+        // Warm the API connection while the user is still typing
+        if (config.prewarm) {
+            api->prewarmConnection();
+        }
+        showUpdateNotice();
         std::string input = readInput();
         
         if (std::cin.fail() || std::cin.eof()) {
@@ -677,6 +1544,8 @@ void OriAssistant::run() {
                 showHelp();
             } else if (input == "/clear") {
                 std::system("clear");
+            } else if (input == "/stats") {
+                std::cout << RequestStats::instance().report();
             } else if (input.rfind("/cat ", 0) == 0) {
                 std::string file_path = input.substr(5);
                 std::ifstream file(file_path);
@@ -684,7 +1553,7 @@ void OriAssistant::run() {
                     std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
                     file.close();
                     std::cout << content << std::endl;
-                    pre_prompt_context += "The user has read the file '" + file_path + "' with the following content:\n---\n" + content + "\n---";
+                    pinned_context += "The user has read the file '" + file_path + "' with the following content:\n---\n" + content + "\n---";
                 } else {
                     std::cout << RED << "Error: could not open file " << file_path << RESET << std::endl;
                 }
@@ -727,15 +1596,109 @@ void OriAssistant::displayCommandLog() {
         for (const auto& entry : command_log) {
             std::cout << "> " << BOLD << CYAN << entry.command << RESET << std::endl;
             std::cout << entry.output << std::endl;
+            if (entry.usage.valid) {
+                char elapsed[32];
+                std::snprintf(elapsed, sizeof(elapsed), "%.1fs", entry.seconds);
+                std::cout << YELLOW << "[" << elapsed << ", " << entry.usage.summary();
+                if (!entry.limit.empty()) std::cout << "; stopped at " << entry.limit;
+                std::cout << "]" << RESET << std::endl;
+            }
         }
     }
     std::cout << BOLD << "---------------------------" << RESET << std::endl;
 }
 
-void OriAssistant::handleResponse(const std::string& response, bool auto_confirm) {
+// Prints a streamed reply as it arrives while hiding [exec], [edit] and
+// [writefile] blocks; handleResponse acts on those once the reply is complete.
+class StreamPrinter {
+public:
+    void write(const std::string& delta) {
+        all_text += delta;
+        pending += delta;
+        drain();
+    }
+
+    void finish() {
+        if (!closing) print(pending);
+        pending.clear();
+        std::cout.flush();
+    }
+
+    bool printedAny() const { return printed; }
+    const std::string& received() const { return all_text; }
+
+private:
+    struct Tag { const char* open; const char* close; };
+
+    void print(const std::string& text) {
+        if (text.empty()) return;
+        if (!printed) {
+            // Same leading blank line handleResponse uses
+            std::cout << "\n";
+            printed = true;
+        }
+        std::cout << text << std::flush;
+    }
+
+    void drain() {
+        static const Tag tags[] = {
+            {"[exec]", "[/exec]"}, {"[edit]", "[/edit]"}, {"[writefile(", "[/writefile]"}
+        };
+        while (!pending.empty()) {
+            if (closing) {
+                size_t end = pending.find(closing);
+                if (end == std::string::npos) {
+                    // Keep a tail that may hold the start of the closing tag
+                    size_t keep = std::min(pending.size(), strlen(closing) - 1);
+                    pending.erase(0, pending.size() - keep);
+                    return;
+                }
+                pending.erase(0, end + strlen(closing));
+                closing = nullptr;
+                continue;
+            }
+
+            size_t bracket = pending.find('[');
+            if (bracket == std::string::npos) {
+                print(pending);
+                pending.clear();
+                return;
+            }
+            print(pending.substr(0, bracket));
+            pending.erase(0, bracket);
+
+            bool partial = false;
+            for (const Tag& tag : tags) {
+                size_t len = strlen(tag.open);
+                if (pending.compare(0, len, tag.open) == 0) {
+                    closing = tag.close;
+                    pending.erase(0, len);
+                    break;
+                }
+                if (pending.size() < len && std::string(tag.open).compare(0, pending.size(), pending) == 0) {
+                    partial = true;
+                }
+            }
+            if (closing) continue;
+            if (partial) return; // wait for more text before deciding
+            print("[");
+            pending.erase(0, 1);
+        }
+    }
+
+    std::string all_text;
+    std::string pending;
+    const char* closing = nullptr;
+    bool printed = false;
+};
+
+void OriAssistant::handleResponse(const std::string& response, bool auto_confirm, bool text_streamed) {
     // Move to a new line to ensure clean output
-    std::cout << "\n";
+    if (!text_streamed) {
+        std::cout << "\n";
+    }
 
+    std::vector<std::string> commands;
     size_t current_pos = 0;
     while (true) {
         // Find next tag: either [exec] or [edit]
@@ -760,7 +1723,7 @@ void OriAssistant::handleResponse(const std::string& response, bool auto_confirm
 
         if (next_tag == NONE) {
             // Print remaining
-            if (current_pos < response.length()) {
+            if (!text_streamed && current_pos < response.length()) {
                 std::string remaining = response.substr(current_pos);
                 std::istringstream iss(remaining);
                 std::string line;
@@ -776,7 +1739,7 @@ void OriAssistant::handleResponse(const std::string& response, bool auto_confirm
         }
 
         // Print any text before the tag
-        if (next_pos > current_pos) {
+        if (!text_streamed && next_pos > current_pos) {
             std::cout << response.substr(current_pos, next_pos - current_pos);
         }
 
@@ -784,8 +1747,8 @@ void OriAssistant::handleResponse(const std::string& response, bool auto_confirm
             // Handle exec block
             if (exec_end == std::string::npos) break; // malformed
             size_t cmd_start = exec_start + strlen("[exec]");
-            std::string command = response.substr(cmd_start, exec_end - cmd_start);
-            handleCommandExecution(command, auto_confirm);
+            // Run after the rest of the reply, so files it writes exist first
+            commands.push_back(response.substr(cmd_start, exec_end - cmd_start));
             current_pos = exec_end + strlen("[/exec]");
             continue;
         } else if (next_tag == EDIT) {
@@ -918,51 +1881,114 @@ void OriAssistant::handleResponse(const std::string& response, bool auto_confirm
             continue;
         }
     }
+
+    if (commands.size() == 1) {
+        handleCommandExecution(commands.front(), auto_confirm);
+    } else if (!commands.empty()) {
+        handleCommandBatch(commands, auto_confirm);
+    }
 }
 
-void OriAssistant::processSingleRequest(const std::string& prompt, bool auto_confirm) {
+void OriAssistant::processSingleRequest(const std::string& prompt, bool auto_confirm, bool tool_output) {
     if (!api) {
         std::cout << RED << "Error: API not initialized" << RESET << std::endl;
         return;
     }
     
-    std::string full_prompt = prompt;
+    // Files and command output gathered with /cat and /exec go out as their
+    // own messages so they can be elided later without losing the question;
+    // files go first and end a prefix the provider may cache
+    if (!pinned_context.empty()) {
+        api->addContext(pinned_context, true);
+        pinned_context.clear();
+    }
     if (!pre_prompt_context.empty()) {
-        full_prompt = pre_prompt_context + "\n" + prompt;
+        api->addContext(pre_prompt_context);
         pre_prompt_context.clear();
     }
     
-    // Get response and handle it
-    handleResponse(api->sendQuery(full_prompt), auto_confirm);
-}
+    if (!config.stream) {
+        // Get response and handle it
+        handleResponse(api->sendQuery(prompt, nullptr, tool_output), auto_confirm);
+        return;
+    }
 
-pid_t popen2(const char *command, int *read_fd) {
-    int pipe_fd[2];
-    if (pipe(pipe_fd) == -1) {
-        return -1;
+    StreamPrinter printer;
+    std::string response = api->sendQuery(prompt, [&printer](const std::string& delta) {
+        printer.write(delta);
+    }, tool_output);
+    printer.finish();
+    if (printer.printedAny()) {
+        std::cout << "\n";
     }
+    // Errors come back instead of the streamed text and still need printing
+    handleResponse(response, auto_confirm, response == printer.received());
+}
 
-    pid_t pid = fork();
-    if (pid == -1) {
-        close(pipe_fd[0]);
-        close(pipe_fd[1]);
-        return -1;
+namespace {
+// Shows command output while it is being captured. Output of a command with
+// a prefix is printed a whole line at a time behind it, so commands running
+// side by side do not cut into each other's lines.
+class CommandOutputPrinter {
+public:
+    explicit CommandOutputPrinter(std::vector<std::string> prefixes)
+        : prefixes(std::move(prefixes)), partial(this->prefixes.size()) {}
+
+    void write(size_t index, const std::string& chunk) {
+        std::string& line = partial[index];
+        if (prefixes[index].empty()) {
+            std::cout << chunk << std::flush;
+            line = chunk.substr(chunk.find_last_of('\n') + 1);
+            return;
+        }
+        line += chunk;
+        size_t end;
+        while ((end = line.find('\n')) != std::string::npos) {
+            std::cout << prefixes[index] << line.substr(0, end + 1);
+            line.erase(0, end + 1);
+        }
+        std::cout << std::flush;
     }
 
-    if (pid == 0) { // child
-        close(pipe_fd[0]); // close read end
-        dup2(pipe_fd[1], STDOUT_FILENO);
-        dup2(pipe_fd[1], STDERR_FILENO); // also redirect stderr
-        close(pipe_fd[1]);
-        setpgid(0, 0); // create new process group
-        execl("/bin/sh", "sh", "-c", command, NULL);
-        _exit(127); // if execl fails
+    // The command exited: end its last line
+    void finish(size_t index) {
+        std::string& line = partial[index];
+        if (line.empty()) return;
+        if (!prefixes[index].empty()) std::cout << prefixes[index] << line;
+        std::cout << "\n" << std::flush;
+        line.clear();
     }
 
-    // parent
-    close(pipe_fd[1]); // close write end
-    *read_fd = pipe_fd[0];
-    return pid;
+private:
+    std::vector<std::string> prefixes;
+    std::vector<std::string> partial; // unfinished last line of each command
+};
+
+std::string describeOutcome(bool approved, const CommandResult& result, const ExecLimits& limits = ExecLimits()) {
+    if (!approved) return "not run: the user declined it";
+    if (result.cancelled) return "cancelled by the user";
+    if (!result.started) return "failed to start";
+    if (!result.limit.empty()) return "stopped: it exceeded " + describeLimit(result.limit, limits);
+    if (WIFSIGNALED(result.status)) return "killed by signal " + std::to_string(WTERMSIG(result.status));
+    return "exit status " + std::to_string(WEXITSTATUS(result.status));
+}
+
+// Which of `count` commands the answer approves: "y" all, otherwise numbers
+// separated by commas or spaces ("1,3"). Anything else approves none.
+std::vector<bool> parseCommandSelection(std::string answer, size_t count) {
+    if (answer == "y" || answer == "Y") return std::vector<bool>(count, true);
+    std::vector<bool> approved(count, false);
+    std::replace(answer.begin(), answer.end(), ',', ' ');
+    std::istringstream in(answer);
+    std::string token;
+    while (in >> token) {
+        if (token.find_first_not_of("0123456789") != std::string::npos) return std::vector<bool>(count, false);
+        size_t number = std::strtoul(token.c_str(), nullptr, 10);
+        if (number == 0 || number > count) return std::vector<bool>(count, false);
+        approved[number - 1] = true;
+    }
+    return approved;
+}
 }
 
 void OriAssistant::handleCommandExecution(const std::string& command, bool auto_confirm, bool send_to_ai) {
@@ -992,75 +2018,40 @@ void OriAssistant::handleCommandExecution(const std::string& command, bool auto_
     }
 
     if (confirmed) {
-        int read_fd;
-        pid_t pid = popen2(command.c_str(), &read_fd);
-        if (pid == -1) {
-            command_log.push_back({command, "Failed to execute command."});
+        // Output shows up as the command writes it, at most a frame at a time
+        CommandOutputPrinter printer({""});
+        ExecOptions options;
+        options.on_output = [&printer](size_t index, const std::string& chunk) { printer.write(index, chunk); };
+        options.on_exit = [&printer](size_t index, const CommandResult&) { printer.finish(index); };
+        options.cancel = &interrupted_flag;
+        options.max_output_bytes = static_cast<size_t>(std::max(0, config.exec_output_bytes));
+        options.limits = execLimitsFrom(config);
+        interrupted_flag = false;
+        CommandResult run = runAssistantCommands({command}, options).front();
+        interrupted_flag = false;
+
+        std::string result = compactOutput(run.output, static_cast<size_t>(std::max(0, config.exec_output_lines)));
+        command_log.push_back({command, result, run.seconds, run.usage,
+                               run.limit.empty() ? "" : describeLimit(run.limit, options.limits)});
+        if (!run.started) {
             return;
         }
-
-        std::string result;
-        char buffer[256];
-        ssize_t bytes_read;
-
-        fcntl(read_fd, F_SETFL, O_NONBLOCK);
-
-        if (!show_command_log) {
-            keep_running = true;
-            interrupted_flag = false;
-            std::thread spinner_thread(run_spinner, "executing command...");
-
-            while (true) {
-                if (interrupted_flag) {
-                    kill(-pid, SIGKILL);
-                    waitpid(pid, NULL, 0);
-                    result += "\n[Command cancelled by user]";
-                    api->sendQuery("User cancelled the command execution.");
-                    break;
-                }
-
-                bytes_read = read(read_fd, buffer, sizeof(buffer) - 1);
-                if (bytes_read > 0) {
-                    buffer[bytes_read] = '\0';
-                    result += buffer;
-                }
-
-                int status;
-                pid_t wait_result = waitpid(pid, &status, WNOHANG);
-                if (wait_result == pid) {
-                    // Drain remaining output
-                    while ((bytes_read = read(read_fd, buffer, sizeof(buffer) - 1)) > 0) {
-                        buffer[bytes_read] = '\0';
-                        result += buffer;
-                    }
-                    break;
-                }
-                if (wait_result == -1) {
-                    break;
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            }
-            keep_running = false;
-            spinner_thread.join();
-        } else {
-            // blocking read when log is shown
-            while ((bytes_read = read(read_fd, buffer, sizeof(buffer) - 1)) > 0) {
-                buffer[bytes_read] = '\0';
-                result += buffer;
-            }
-            waitpid(pid, NULL, 0);
+        if (!run.limit.empty()) {
+            std::cout << YELLOW << "Command stopped: it exceeded " << describeLimit(run.limit, options.limits) << "."
+                      << RESET << std::endl;
+        }
+        if (config.exec_persistent_shell && !shell_session.running()) {
+            std::cout << YELLOW << "The shell exited; the next command starts a new one without the variables set before."
+                      << RESET << std::endl;
+        }
+        if (run.cancelled) {
+            api->sendQuery("User cancelled the command execution.");
         }
-        
-        interrupted_flag = false;
-        close(read_fd);
-
-        command_log.push_back({command, result});
 
         if (send_to_ai) {
             std::string feedback_prompt = "The command \"" + command + "\" produced the following output:\n---\n" + result + "\n---\nPlease summarize this output or answer the original question based on it.";
-            processSingleRequest(feedback_prompt, auto_confirm);
+            processSingleRequest(feedback_prompt, auto_confirm, true);
         } else {
-            std::cout << result << std::endl;
             pre_prompt_context += "The user executed the command `" + command + "` with the following output:\n---\n" + result + "\n---";
         }
     } else {
@@ -1069,74 +2060,178 @@ void OriAssistant::handleCommandExecution(const std::string& command, bool auto_
     }
 }
 
+std::vector<CommandResult> OriAssistant::runAssistantCommands(const std::vector<std::string>& commands,
+                                                              const ExecOptions& options) {
+    if (!config.exec_persistent_shell) {
+        shell_session.stop();
+        return runCommands(commands, options);
+    }
+    // One shell runs them in order; once cancel is set the rest come back cancelled
+    std::vector<CommandResult> results;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        ExecOptions one = options;
+        one.on_output = [&options, i](size_t, const std::string& chunk) {
+            if (options.on_output) options.on_output(i, chunk);
+        };
+        one.on_exit = [&options, i](size_t, const CommandResult& result) {
+            if (options.on_exit) options.on_exit(i, result);
+        };
+        results.push_back(shell_session.run(commands[i], one));
+    }
+    return results;
+}
+
+void OriAssistant::handleCommandBatch(const std::vector<std::string>& commands, bool auto_confirm) {
+    std::vector<bool> approved(commands.size(), true);
+    if (!auto_confirm) {
+        for (const auto& command : commands) {
+            if (command.find("sudo") != std::string::npos || command.find(" su ") != std::string::npos) {
+                std::cout << YELLOW << "Warning: a command below requests elevated privileges (contains 'sudo' or 'su'). It may prompt for a password when run." << RESET << std::endl;
+                break;
+            }
+        }
+        std::cout << YELLOW << "Execute the following " << commands.size() << " commands?" << RESET << "\n";
+        for (size_t i = 0; i < commands.size(); ++i) {
+            std::cout << "  " << (i + 1) << ". " << BOLD << CYAN << "<< " << commands[i] << " >>" << RESET << "\n";
+        }
+        std::cout << YELLOW << "(y = all, n = none, or numbers such as 1,3): " << RESET;
+        std::string confirmation;
+        interrupted_flag = false;
+        std::getline(std::cin, confirmation);
+        if (std::cin.fail() || interrupted_flag) {
+            std::cin.clear();
+            interrupted_flag = false;
+            confirmation = "n";
+            std::cout << std::endl;
+        }
+        approved = parseCommandSelection(confirmation, commands.size());
+    }
+
+    // Approved commands and the number each was listed under
+    std::vector<std::string> to_run;
+    std::vector<size_t> numbers;
+    std::vector<std::string> prefixes;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        if (!approved[i]) continue;
+        to_run.push_back(commands[i]);
+        numbers.push_back(i + 1);
+        prefixes.push_back(CYAN + "[" + std::to_string(i + 1) + "] " + RESET);
+    }
+    if (to_run.empty()) {
+        std::cout << YELLOW << "Command execution cancelled." << RESET << "\n\n";
+        api->sendQuery("The user cancelled the command execution. Please inform the user that you cannot answer the question without running the commands.");
+        return;
+    }
+
+    CommandOutputPrinter printer(prefixes);
+    ExecOptions options;
+    options.parallelism = static_cast<size_t>(std::max(1, config.exec_parallelism));
+    options.max_output_bytes = static_cast<size_t>(std::max(0, config.exec_output_bytes));
+    options.limits = execLimitsFrom(config);
+    options.on_output = [&printer](size_t index, const std::string& chunk) { printer.write(index, chunk); };
+    options.on_exit = [&](size_t index, const CommandResult& result) {
+        printer.finish(index);
+        bool ok = result.started && !result.cancelled && WIFEXITED(result.status) && WEXITSTATUS(result.status) == 0;
+        std::cout << (ok ? GREEN : YELLOW) << "[" << numbers[index] << "] " << RESET << to_run[index] << " ("
+                  << describeOutcome(true, result, options.limits);
+        if (result.started) {
+            char elapsed[32];
+            std::snprintf(elapsed, sizeof(elapsed), ", %.1fs", result.seconds);
+            std::cout << elapsed;
+        }
+        std::cout << ")" << std::endl;
+    };
+    options.cancel = &interrupted_flag;
+    interrupted_flag = false;
+    std::vector<CommandResult> results = runAssistantCommands(to_run, options);
+    interrupted_flag = false;
+    std::cout << std::endl;
+
+    std::string feedback_prompt = "The commands you asked for were handled as follows:\n";
+    size_t next_result = 0;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        feedback_prompt += "\n[" + std::to_string(i + 1) + "] `" + commands[i] + "`: ";
+        if (!approved[i]) {
+            feedback_prompt += describeOutcome(false, CommandResult()) + "\n";
+            continue;
+        }
+        const CommandResult& result = results[next_result++];
+        std::string output = compactOutput(result.output, static_cast<size_t>(std::max(0, config.exec_output_lines)));
+        command_log.push_back({commands[i], output, result.seconds, result.usage,
+                               result.limit.empty() ? "" : describeLimit(result.limit, options.limits)});
+        feedback_prompt += describeOutcome(true, result, options.limits);
+        if (result.started) feedback_prompt += ", output:\n---\n" + output + "\n---";
+        feedback_prompt += "\n";
+    }
+    feedback_prompt += "\nPlease summarize this output or answer the original question based on it.";
+    processSingleRequest(feedback_prompt, auto_confirm, true);
+}
+
 void OriAssistant::setExecutablePath(const std::string& path) {
     executable_path = path;
 }
 
 void OriAssistant::checkForUpdates(bool silent) {
+    std::string cache_path;
+    if (const char* home_dir = std::getenv("HOME")) {
+        cache_path = std::string(home_dir) + "/.config/ori/update_check.json";
+    }
+    if (silent) {
+        // Never wait on the network here; the notice is printed at the prompt
+        update_checker.startBackground(cache_path);
+        return;
+    }
+
     #ifdef CURL_FOUND
-    CURL* curl = curl_easy_init();
-    if (curl) {
-        std::string version_url = "https://raw.githubusercontent.com/piratheon/ORI/refs/heads/main/.version";
-        std::string remote_version;
-        curl_easy_setopt(curl, CURLOPT_URL, version_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &remote_version);
-        CURLcode res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-
-        if (res == CURLE_OK) {
-            std::ifstream version_file(".version");
-            std::string current_version = "1.1.4";
-            if (version_file.is_open()) {
-                std::getline(version_file, current_version);
-                version_file.close();
-            }
-            remote_version.erase(remote_version.find_last_not_of(" \n\r\t")+1);
-            if (current_version != remote_version) {
-                if (silent) {
-                    std::cout << YELLOW << "A new version of Ori is available: " << remote_version << RESET << std::endl;
-                    std::cout << "Run " << BOLD << "ori --check-for-updates" << RESET << " to update." << std::endl;
-                } else {
-                    std::cout << YELLOW << "A new version of Ori is available: " << remote_version << RESET << std::endl;
-                    std::cout << "Do you want to update? (y/n): ";
-                    std::string confirmation;
-                    std::getline(std::cin, confirmation);
-                    if (confirmation == "y" || confirmation == "Y") {
-                        std::string download_url = "https://github.com/piratheon/ORI/releases/download/v" + remote_version + "/ori-linux_x86-64-v" + remote_version + ".bin";
-                        std::string temp_file = "/tmp/ori_update.bin";
-                        CURL* download_curl = curl_easy_init();
-                        if (download_curl) {
-                            FILE* fp = fopen(temp_file.c_str(), "wb");
-                            if (fp) {
-                                curl_easy_setopt(download_curl, CURLOPT_URL, download_url.c_str());
-                                curl_easy_setopt(download_curl, CURLOPT_WRITEFUNCTION, NULL);
-                                curl_easy_setopt(download_curl, CURLOPT_WRITEDATA, fp);
-                                CURLcode download_res = curl_easy_perform(download_curl);
-                                fclose(fp);
-                                if (download_res == CURLE_OK) {
-                                    chmod(temp_file.c_str(), 0755);
-                                    if (rename(temp_file.c_str(), executable_path.c_str()) == 0) {
-                                        std::cout << GREEN << "Update successful! Restarting Ori..." << RESET << std::endl;
-                                        char* const argv[] = {const_cast<char*>(executable_path.c_str()), NULL};
-                                        execv(executable_path.c_str(), argv);
-                                    } else {
-                                        std::cout << RED << "Failed to replace the old binary." << RESET << std::endl;
-                                    }
-                                } else {
-                                    std::cout << RED << "Failed to download the update." << RESET << std::endl;
-                                }
-                            }
-                            curl_easy_cleanup(download_curl);
+    std::string remote_version = UpdateChecker::fetchLatest(UpdateChecker::INTERACTIVE_TIMEOUT_MS, cache_path);
+    if (remote_version.empty()) {
+        std::cout << RED << "Error: could not reach the update server." << RESET << std::endl;
+        return;
+    }
+    if (UpdateChecker::currentVersion() != remote_version) {
+        std::cout << YELLOW << "A new version of Ori is available: " << remote_version << RESET << std::endl;
+        std::cout << "Do you want to update? (y/n): ";
+        std::string confirmation;
+        std::getline(std::cin, confirmation);
+        if (confirmation == "y" || confirmation == "Y") {
+            std::string download_url = "https://github.com/piratheon/ORI/releases/download/v" + remote_version + "/ori-linux_x86-64-v" + remote_version + ".bin";
+            std::string temp_file = "/tmp/ori_update.bin";
+            CURL* download_curl = curl_easy_init();
+            if (download_curl) {
+                FILE* fp = fopen(temp_file.c_str(), "wb");
+                if (fp) {
+                    curl_easy_setopt(download_curl, CURLOPT_URL, download_url.c_str());
+                    curl_easy_setopt(download_curl, CURLOPT_WRITEFUNCTION, NULL);
+                    curl_easy_setopt(download_curl, CURLOPT_WRITEDATA, fp);
+                    CURLcode download_res = curl_easy_perform(download_curl);
+                    fclose(fp);
+                    if (download_res == CURLE_OK) {
+                        chmod(temp_file.c_str(), 0755);
+                        if (rename(temp_file.c_str(), executable_path.c_str()) == 0) {
+                            std::cout << GREEN << "Update successful! Restarting Ori..." << RESET << std::endl;
+                            char* const argv[] = {const_cast<char*>(executable_path.c_str()), NULL};
+                            execv(executable_path.c_str(), argv);
+                        } else {
+                            std::cout << RED << "Failed to replace the old binary." << RESET << std::endl;
                         }
+                    } else {
+                        std::cout << RED << "Failed to download the update." << RESET << std::endl;
                     }
                 }
+                curl_easy_cleanup(download_curl);
             }
         }
     }
     #endif
 }
 
+void OriAssistant::showUpdateNotice(const char* newline) {
+    std::string notice = update_checker.takeNotice();
+    if (notice.empty()) return;
+    std::cout << YELLOW << notice << RESET << newline
+              << "Run " << BOLD << "ori --check-for-updates" << RESET << " to update." << newline << std::flush;
+}
+
 void OriAssistant::showHelp() {
     std::cout << "Available commands:\n";
     std::cout << "  /help          - Show this help message\n";
@@ -1145,6 +2240,7 @@ void OriAssistant::showHelp() {
     std::cout << "  /clear         - Clear the screen\n";
     std::cout << "  /cat [file]    - Print file content and add it to the chat context\n";
     std::cout << "  /exec [cmd]    - Execute a shell command and add the output to the chat context\n";
+    std::cout << "  /stats         - Show where recent requests spent their time\n";
     std::cout << "  Or type any query to send to the AI assistant\n\n";
     std::cout << "KEYBINDINGS:\n";
     std::cout << "  Ctrl+F         - Toggle command execution log\n";
@@ -0,0 +1,719 @@
+#include "ori_exec.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <random>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const size_t READ_SIZE = 64 * 1024;
+// Most one drain() call reads, so a writer that keeps the pipe full cannot
+// hold the loop away from flushing, limits and cancel
+const size_t MAX_READ_PER_ROUND = 1024 * 1024;
+// Output read but not yet handed to on_output, per command. Once this much is
+// waiting the pipe is left alone until the next flush, and the writer blocks.
+const size_t MAX_PENDING_BYTES = 4 * 1024 * 1024;
+// How often to look for exited children when there is no pidfd to wake us
+const int FALLBACK_TICK_MS = 20;
+// Upper bound on one poll() so a cancel set from another thread is noticed
+const int CANCEL_TICK_MS = 100;
+// ShellSession's marker is this plus a random token per session
+const char MARKER_PREFIX[] = "__ori_done_";
+// How long a shell must sit idle with its output sent elsewhere before
+// ShellSession gives up on the marker
+const int LOST_OUTPUT_GRACE_MS = 1000;
+
+int openPidFd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// Append what can be read from a nonblocking pipe, up to about max_bytes;
+// false once it is closed
+bool drain(int fd, std::string& out, size_t max_bytes = MAX_READ_PER_ROUND) {
+    char buffer[READ_SIZE];
+    size_t this_round = 0;
+    while (this_round < max_bytes) {
+        ssize_t bytes_read = read(fd, buffer, std::min(sizeof(buffer), max_bytes - this_round));
+        if (bytes_read > 0) {
+            out.append(buffer, bytes_read);
+            this_round += bytes_read;
+        } else if (bytes_read == 0) {
+            return false;
+        } else if (errno != EINTR) {
+            return true;
+        }
+    }
+    return true;
+}
+
+// How much drain() may add to `waiting` bytes of unflushed output
+size_t readRoom(size_t waiting) {
+    return waiting < MAX_PENDING_BYTES ? std::min(MAX_PENDING_BYTES - waiting, MAX_READ_PER_ROUND) : 0;
+}
+
+struct Running {
+    size_t index;
+    ChildProcess child;
+    Clock::time_point started;
+    std::string pending; // read but not yet handed to on_output
+    Clock::time_point deadline; // for limits.timeout_s
+};
+
+bool writeFile(const std::string& path, const std::string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    bool ok = write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size());
+    close(fd);
+    return ok;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Value of `key` in a flat-keyed cgroup file such as memory.events
+long long readKey(const std::string& path, const std::string& key) {
+    std::istringstream in(readFile(path));
+    std::string name;
+    long long value;
+    while (in >> name >> value) {
+        if (name == key) return value;
+    }
+    return 0;
+}
+
+// The cgroup v2 directory this process is in, or "" without a unified hierarchy
+const std::string& ownCgroupDir() {
+    static const std::string dir = [] {
+        std::string mount;
+        std::ifstream info("/proc/self/mountinfo");
+        std::string line;
+        while (std::getline(info, line)) {
+            if (line.find(" - cgroup2 ") == std::string::npos) continue;
+            std::istringstream fields(line);
+            std::string skip;
+            fields >> skip >> skip >> skip >> skip >> mount; // the fifth field is the mount point
+            break;
+        }
+        if (mount.empty()) return std::string();
+        std::ifstream self("/proc/self/cgroup");
+        while (std::getline(self, line)) {
+            if (line.compare(0, 3, "0::") == 0) return mount + line.substr(3);
+        }
+        return std::string();
+    }();
+    return dir;
+}
+
+// A sub-group enforcing the memory and process limits, or "" when the
+// controllers are not handed down to us. Once that fails it is not retried.
+std::string createCgroup(const ExecLimits& limits) {
+    static std::atomic<bool> unusable{false};
+    static std::atomic<unsigned> counter{0};
+    if ((limits.memory_mb == 0 && limits.max_processes == 0) || unusable || ownCgroupDir().empty()) return "";
+
+    std::string dir = ownCgroupDir() + "/ori-exec-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    if (mkdir(dir.c_str(), 0755) != 0) {
+        unusable = true;
+        return "";
+    }
+    std::string controllers = " " + readFile(dir + "/cgroup.controllers");
+    bool ok = (limits.memory_mb == 0 || controllers.find(" memory") != std::string::npos) &&
+              (limits.max_processes == 0 || controllers.find(" pids") != std::string::npos);
+    if (ok && limits.memory_mb > 0) ok = writeFile(dir + "/memory.max", std::to_string(limits.memory_mb * 1024 * 1024));
+    if (ok && limits.max_processes > 0) ok = writeFile(dir + "/pids.max", std::to_string(limits.max_processes));
+    if (!ok) {
+        rmdir(dir.c_str());
+        unusable = true;
+        return "";
+    }
+    return dir;
+}
+
+void removeCgroup(const std::string& dir) {
+    // Stragglers the shell left in the background go with it
+    writeFile(dir + "/cgroup.kill", "1");
+    for (int attempt = 0; attempt < 50 && rmdir(dir.c_str()) != 0 && errno == EBUSY; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+// Tasks (threads, which is what RLIMIT_NPROC counts on Linux) the real user
+// runs right now, Ori's own included, so the limit can leave room for them
+long userTaskCount() {
+    uid_t uid = getuid();
+    long count = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.find_first_not_of("0123456789") != std::string::npos) continue;
+        // The real uid is the first field of Uid:
+        std::istringstream status(readFile(entry.path().string() + "/status"));
+        std::string line;
+        long real_uid = -1;
+        long threads = 0;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 4, "Uid:") == 0) real_uid = std::atol(line.c_str() + 4);
+            if (line.compare(0, 8, "Threads:") == 0) threads = std::atol(line.c_str() + 8);
+        }
+        if (real_uid == static_cast<long>(uid)) count += threads;
+    }
+    return count;
+}
+
+// `text` as one single-quoted shell word
+std::string shellQuote(const std::string& text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+// CPU seconds of a live process plus the children it has waited for
+bool readCpuTimes(pid_t pid, double& user_s, double& system_s) {
+    std::string stat = readFile("/proc/" + std::to_string(pid) + "/stat");
+    size_t name_end = stat.rfind(')');
+    if (name_end == std::string::npos) return false;
+    // After the name: state is field 3, utime/stime/cutime/cstime fields 14-17
+    std::istringstream fields(stat.substr(name_end + 2));
+    std::string skip;
+    for (int field = 3; field < 14; ++field) fields >> skip;
+    long long utime, stime, cutime, cstime;
+    if (!(fields >> utime >> stime >> cutime >> cstime)) return false;
+    double tick = static_cast<double>(sysconf(_SC_CLK_TCK));
+    user_s = (utime + cutime) / tick;
+    system_s = (stime + cstime) / tick;
+    return true;
+}
+
+// Whether the shell is idle, waiting for its next command, with its stdout no
+// longer on our pipe (`exec >/dev/null`): the marker went there and will not
+// arrive. False whenever /proc cannot tell.
+bool shellLostOutput(const ChildProcess& shell) {
+    const std::string proc = "/proc/" + std::to_string(shell.pid);
+    struct stat ours, theirs;
+    if (fstat(shell.out_fd, &ours) != 0 || stat((proc + "/fd/1").c_str(), &theirs) != 0) return false;
+    if (ours.st_dev == theirs.st_dev && ours.st_ino == theirs.st_ino) return false;
+    // Sleeping (not running a builtin loop) and without children (not waiting on a command)
+    std::string stat_text = readFile(proc + "/stat");
+    size_t name_end = stat_text.rfind(')');
+    if (name_end == std::string::npos || name_end + 2 >= stat_text.size() || stat_text[name_end + 2] != 'S') return false;
+    const std::string children = proc + "/task/" + std::to_string(shell.pid) + "/children";
+    if (access(children.c_str(), R_OK) != 0) return false;
+    return readFile(children).find_first_not_of(" \n") == std::string::npos;
+}
+
+bool sameLimits(const ExecLimits& a, const ExecLimits& b) {
+    return a.timeout_s == b.timeout_s && a.cpu_s == b.cpu_s && a.memory_mb == b.memory_mb &&
+           a.max_output == b.max_output && a.max_processes == b.max_processes;
+}
+
+std::string formatBytes(long long bytes) {
+    char text[32];
+    if (bytes < 1024) {
+        std::snprintf(text, sizeof(text), "%lld B", bytes);
+    } else if (bytes < 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    } else {
+        std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+    }
+    return text;
+}
+}
+
+std::string ResourceUsage::summary() const {
+    char cpu[64];
+    std::snprintf(cpu, sizeof(cpu), "cpu %.2fs (%.2f user)", user_s + system_s, user_s);
+    std::string text = cpu;
+    // Not known for a command run in a ShellSession
+    if (peak_rss_kb > 0) text += ", peak " + formatBytes(peak_rss_kb * 1024);
+    if (read_bytes > 0 || written_bytes > 0) {
+        text += ", I/O " + formatBytes(read_bytes) + " in / " + formatBytes(written_bytes) + " out";
+    }
+    return text;
+}
+
+std::string describeLimit(const std::string& limit, const ExecLimits& limits) {
+    if (limit == "timeout") return "the " + std::to_string(limits.timeout_s) + " s time limit";
+    if (limit == "output") return "the " + formatBytes(static_cast<long long>(limits.max_output)) + " output limit";
+    if (limit == "cpu") return "the " + std::to_string(limits.cpu_s) + " s CPU limit";
+    if (limit == "memory") return "the " + std::to_string(limits.memory_mb) + " MB memory limit";
+    return limit;
+}
+
+bool spawnCommand(const std::string& command, ChildProcess& child, const ExecLimits& limits, bool send_stdin) {
+    int pipe_fd[2];
+    // Close-on-exec, so commands started side by side do not hold each other's pipes open
+    if (pipe2(pipe_fd, O_CLOEXEC) == -1) {
+        return false;
+    }
+    int in_fd[2] = {-1, -1};
+    if (send_stdin && socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, in_fd) == -1) {
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
+        return false;
+    }
+
+    // Everything the child needs is worked out before the fork
+    std::string cgroup = createCgroup(limits);
+    std::string cgroup_procs = cgroup.empty() ? "" : cgroup + "/cgroup.procs";
+    rlim_t nproc = 0;
+    if (cgroup.empty() && limits.max_processes > 0) nproc = userTaskCount() + limits.max_processes;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
+        if (send_stdin) {
+            close(in_fd[0]);
+            close(in_fd[1]);
+        }
+        if (!cgroup.empty()) rmdir(cgroup.c_str());
+        return false;
+    }
+
+    if (pid == 0) { // child
+        dup2(pipe_fd[1], STDOUT_FILENO);
+        dup2(pipe_fd[1], STDERR_FILENO); // also redirect stderr
+        if (send_stdin) dup2(in_fd[0], STDIN_FILENO);
+        setpgid(0, 0); // create new process group
+        if (!cgroup_procs.empty()) {
+            int procs = open(cgroup_procs.c_str(), O_WRONLY);
+            if (procs != -1) {
+                ssize_t ignored = write(procs, "0", 1);
+                (void)ignored;
+                close(procs);
+            }
+        }
+        if (limits.cpu_s > 0) {
+            // SIGXCPU at the limit, SIGKILL a second later if that is ignored
+            struct rlimit cpu = {static_cast<rlim_t>(limits.cpu_s), static_cast<rlim_t>(limits.cpu_s) + 1};
+            setrlimit(RLIMIT_CPU, &cpu);
+        }
+        if (cgroup_procs.empty() && limits.memory_mb > 0) {
+            struct rlimit memory = {static_cast<rlim_t>(limits.memory_mb) * 1024 * 1024,
+                                    static_cast<rlim_t>(limits.memory_mb) * 1024 * 1024};
+            setrlimit(RLIMIT_AS, &memory);
+        }
+        if (nproc > 0) {
+            struct rlimit processes = {nproc, nproc};
+            setrlimit(RLIMIT_NPROC, &processes);
+        }
+        execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+        _exit(127); // if execl fails
+    }
+
+    // parent
+    close(pipe_fd[1]);
+    fcntl(pipe_fd[0], F_SETFL, O_NONBLOCK);
+    if (send_stdin) {
+        close(in_fd[0]);
+        shutdown(in_fd[1], SHUT_RD);
+    }
+    child.pid = pid;
+    child.out_fd = pipe_fd[0];
+    child.in_fd = in_fd[1];
+    child.pid_fd = openPidFd(pid);
+    child.cgroup = cgroup;
+    return true;
+}
+
+bool childExited(const ChildProcess& child) {
+    // WNOWAIT leaves the zombie, so the pid cannot be recycled before reapChild
+    siginfo_t info = {};
+    return waitid(P_PID, child.pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid != 0;
+}
+
+void signalChild(const ChildProcess& child, int sig) {
+    kill(-child.pid, sig);
+    if (sig == SIGKILL && !child.cgroup.empty()) writeFile(child.cgroup + "/cgroup.kill", "1");
+}
+
+void reapChild(ChildProcess& child, const ExecLimits& limits, int& status, ResourceUsage& usage, std::string& limit) {
+    struct rusage ru = {};
+    if (wait4(child.pid, &status, 0, &ru) == child.pid) {
+        usage.valid = true;
+        usage.user_s = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+        usage.system_s = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+        usage.peak_rss_kb = ru.ru_maxrss;
+        usage.read_bytes = ru.ru_inblock * 512LL;
+        usage.written_bytes = ru.ru_oublock * 512LL;
+    }
+    if (child.pid_fd >= 0) {
+        close(child.pid_fd);
+        child.pid_fd = -1;
+    }
+    // The shell itself, or a command it waited for and then reported as 128 + signal
+    int signal = WIFSIGNALED(status) ? WTERMSIG(status) : WIFEXITED(status) ? WEXITSTATUS(status) - 128 : 0;
+    // (CPU time is accounted in ticks, so allow for it coming out just under)
+    double cpu = usage.user_s + usage.system_s;
+    if (limit.empty() && limits.cpu_s > 0 && cpu >= limits.cpu_s * 0.9 && (signal == SIGXCPU || signal == SIGKILL)) {
+        limit = "cpu";
+    }
+    if (!child.cgroup.empty()) {
+        // The whole group's high-water mark, not just its largest process
+        long long peak = std::atoll(readFile(child.cgroup + "/memory.peak").c_str());
+        if (peak > 0) usage.peak_rss_kb = peak / 1024;
+        if (limit.empty() && readKey(child.cgroup + "/memory.events", "oom_kill") > 0) limit = "memory";
+        removeCgroup(child.cgroup);
+        child.cgroup.clear();
+    }
+}
+
+std::vector<CommandResult> runCommands(const std::vector<std::string>& commands, const ExecOptions& options) {
+    std::vector<CommandResult> results(commands.size());
+    for (auto& result : results) result.output = OutputCapture(options.max_output_bytes);
+    std::vector<Running> running;
+    size_t parallelism = std::max<size_t>(1, options.parallelism);
+    size_t next = 0;
+    bool cancelled = false;
+    const auto flush_interval = std::chrono::milliseconds(options.flush_interval_ms);
+    Clock::time_point last_flush = Clock::now() - flush_interval;
+
+    const ExecLimits& limits = options.limits;
+    // Stop a command past its deadline, or once its output passes the cap
+    // (keeping output up to the cap and dropping the rest)
+    auto enforceLimits = [&](Running& run, CommandResult& result) {
+        if (limits.max_output > 0) {
+            unsigned long long seen = result.output.totalBytes() + run.pending.size();
+            if (seen > limits.max_output) {
+                run.pending.resize(run.pending.size() - std::min<unsigned long long>(run.pending.size(), seen - limits.max_output));
+                if (result.limit.empty()) {
+                    result.limit = "output";
+                    signalChild(run.child, SIGKILL);
+                }
+            }
+        }
+        if (result.limit.empty() && !result.cancelled && Clock::now() >= run.deadline) {
+            result.limit = "timeout";
+            signalChild(run.child, SIGKILL);
+        }
+    };
+
+    auto flush = [&](Running& run) {
+        if (run.pending.empty()) return;
+        if (options.on_output) options.on_output(run.index, run.pending);
+        results[run.index].output.append(run.pending);
+        run.pending.clear();
+    };
+
+    while (next < commands.size() || !running.empty()) {
+        if (options.cancel && *options.cancel && !cancelled) {
+            cancelled = true;
+            for (auto& run : running) {
+                signalChild(run.child, SIGKILL);
+                results[run.index].cancelled = true;
+            }
+            for (; next < commands.size(); ++next) {
+                results[next].cancelled = true;
+                if (options.on_exit) options.on_exit(next, results[next]);
+            }
+        }
+
+        while (running.size() < parallelism && next < commands.size()) {
+            size_t index = next++;
+            Running run{index, ChildProcess(), Clock::now(), std::string(), Clock::time_point::max()};
+            if (limits.timeout_s > 0) run.deadline = run.started + std::chrono::seconds(limits.timeout_s);
+            if (!spawnCommand(commands[index], run.child, limits)) {
+                results[index].output.append("Failed to execute command.");
+                if (options.on_exit) options.on_exit(index, results[index]);
+                continue;
+            }
+            results[index].started = true;
+            running.push_back(std::move(run));
+        }
+        if (running.empty()) continue;
+
+        std::vector<pollfd> fds;
+        bool all_have_pidfd = true;
+        bool any_pending = false;
+        Clock::time_point next_deadline = Clock::time_point::max();
+        for (const auto& run : running) {
+            next_deadline = std::min(next_deadline, run.deadline);
+            if (run.child.out_fd >= 0 && readRoom(run.pending.size()) > 0) fds.push_back({run.child.out_fd, POLLIN, 0});
+            if (run.child.pid_fd >= 0) {
+                fds.push_back({run.child.pid_fd, POLLIN, 0});
+            } else {
+                all_have_pidfd = false;
+            }
+            if (!run.pending.empty()) any_pending = true;
+        }
+        int timeout_ms = all_have_pidfd ? CANCEL_TICK_MS : FALLBACK_TICK_MS;
+        if (any_pending) {
+            auto until_flush = std::chrono::duration_cast<std::chrono::milliseconds>(last_flush + flush_interval - Clock::now());
+            timeout_ms = std::max(0, std::min(timeout_ms, static_cast<int>(until_flush.count())));
+        }
+        if (next_deadline != Clock::time_point::max()) {
+            auto until_deadline = std::chrono::duration_cast<std::chrono::milliseconds>(next_deadline - Clock::now());
+            timeout_ms = std::max(0, std::min(timeout_ms, static_cast<int>(until_deadline.count()) + 1));
+        }
+        // EINTR is fine: Ctrl-C is exactly what should wake us
+        poll(fds.data(), fds.size(), timeout_ms);
+
+        for (auto it = running.begin(); it != running.end();) {
+            Running& run = *it;
+            size_t room = readRoom(run.pending.size());
+            if (run.child.out_fd >= 0 && room > 0 && !drain(run.child.out_fd, run.pending, room)) {
+                close(run.child.out_fd);
+                run.child.out_fd = -1;
+            }
+            CommandResult& result = results[run.index];
+            enforceLimits(run, result);
+            if (!childExited(run.child)) {
+                ++it;
+                continue;
+            }
+            // Exited. A background child may still hold the pipe open, so
+            // take what is there and stop reading.
+            if (run.child.out_fd >= 0) {
+                drain(run.child.out_fd, run.pending);
+                close(run.child.out_fd);
+            }
+            enforceLimits(run, result);
+            reapChild(run.child, limits, result.status, result.usage, result.limit);
+            flush(run);
+            if (result.cancelled) {
+                result.output.append("\n[Command cancelled by user]");
+            } else if (!result.limit.empty()) {
+                result.output.append("\n[Command stopped: it exceeded " + describeLimit(result.limit, limits) + "]");
+            }
+            result.output.finish();
+            result.seconds = std::chrono::duration<double>(Clock::now() - run.started).count();
+            if (options.on_exit) options.on_exit(run.index, result);
+            it = running.erase(it);
+        }
+
+        if (Clock::now() - last_flush >= flush_interval) {
+            bool flushed = false;
+            for (auto& run : running) {
+                flushed = flushed || !run.pending.empty();
+                flush(run);
+            }
+            if (flushed) last_flush = Clock::now();
+        }
+    }
+    return results;
+}
+
+ShellSession::~ShellSession() {
+    stop();
+}
+
+void ShellSession::stop() {
+    if (!running()) return;
+    signalChild(shell, SIGKILL);
+    int status;
+    ResourceUsage usage;
+    std::string limit;
+    reapChild(shell, limits, status, usage, limit);
+    if (shell.out_fd >= 0) close(shell.out_fd);
+    if (shell.in_fd >= 0) close(shell.in_fd);
+    shell = ChildProcess();
+}
+
+bool ShellSession::start(const ExecLimits& new_limits) {
+    if (marker.empty()) {
+        std::mt19937_64 rng(std::random_device{}());
+        char text[20];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(rng()));
+        marker_token = text;
+        marker = std::string(MARKER_PREFIX) + marker_token;
+    }
+    std::string command = access("/bin/bash", X_OK) == 0 ? "exec /bin/bash --noprofile --norc" : "exec /bin/sh";
+    if (!cwd.empty()) command = "cd " + shellQuote(cwd) + " 2>/dev/null; " + command;
+    if (!spawnCommand(command, shell, new_limits, true)) return false;
+    limits = new_limits;
+    return true;
+}
+
+CommandResult ShellSession::run(const std::string& command, const ExecOptions& options) {
+    CommandResult result;
+    result.output = OutputCapture(options.max_output_bytes);
+    auto finish = [&]() {
+        result.output.finish();
+        if (options.on_exit) options.on_exit(0, result);
+        return result;
+    };
+    if (options.cancel && *options.cancel) {
+        result.cancelled = true;
+        return finish();
+    }
+    if (running() && !sameLimits(limits, options.limits)) stop();
+    if (!running() && !start(options.limits)) {
+        result.output.append("Failed to start the shell.");
+        return finish();
+    }
+    result.started = true;
+
+    // The command's stdin is /dev/null: the shell's own is where the next command comes from.
+    // printf joins the marker's two halves, so it never appears whole in what the shell
+    // reads (and echoes under `set -v`); the leading newline puts it at the start of a line.
+    std::string frame = "eval " + shellQuote(command) + " </dev/null; printf '\\n%s%s %d %s\\n' " +
+                        std::string(MARKER_PREFIX) + " " + marker_token + " \"$?\" \"$PWD\"\n";
+    const std::string needle = "\n" + marker;
+    const Clock::time_point started = Clock::now();
+    double user_before = 0, system_before = 0;
+    readCpuTimes(shell.pid, user_before, system_before);
+    bool sent = send(shell.in_fd, frame.data(), frame.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(frame.size());
+
+    const auto flush_interval = std::chrono::milliseconds(options.flush_interval_ms);
+    const Clock::time_point deadline =
+        options.limits.timeout_s > 0 ? started + std::chrono::seconds(options.limits.timeout_s) : Clock::time_point::max();
+    Clock::time_point last_flush = started - flush_interval;
+    std::string buffer;  // read, and possibly holding the start of the marker
+    std::string pending; // command output not yet handed to on_output
+    bool done = false;
+    bool shell_died = !sent;
+    bool lost_output = false;
+    Clock::time_point lost_since = Clock::time_point::max();
+
+    auto flush = [&]() {
+        if (pending.empty()) return;
+        if (options.on_output) options.on_output(0, pending);
+        result.output.append(pending);
+        pending.clear();
+        last_flush = Clock::now();
+    };
+    auto kill_shell = [&](const std::string& limit) {
+        if (result.limit.empty() && !result.cancelled) {
+            if (limit.empty()) {
+                result.cancelled = true;
+            } else {
+                result.limit = limit;
+            }
+        }
+        signalChild(shell, SIGKILL);
+    };
+
+    while (!done && !shell_died) {
+        if (options.cancel && *options.cancel && !result.cancelled) kill_shell("");
+        if (Clock::now() >= deadline && result.limit.empty()) kill_shell("timeout");
+
+        const size_t room = readRoom(pending.size());
+        std::vector<pollfd> fds;
+        if (room > 0) fds.push_back({shell.out_fd, POLLIN, 0});
+        if (shell.pid_fd >= 0) fds.push_back({shell.pid_fd, POLLIN, 0});
+        int timeout_ms = shell.pid_fd >= 0 ? CANCEL_TICK_MS : FALLBACK_TICK_MS;
+        if (!pending.empty()) {
+            auto until_flush = std::chrono::duration_cast<std::chrono::milliseconds>(last_flush + flush_interval - Clock::now());
+            timeout_ms = std::max(0, std::min(timeout_ms, static_cast<int>(until_flush.count())));
+        }
+        if (deadline != Clock::time_point::max()) {
+            auto until_deadline = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            timeout_ms = std::max(0, std::min(timeout_ms, static_cast<int>(until_deadline.count()) + 1));
+        }
+        poll(fds.data(), fds.size(), timeout_ms);
+
+        bool open = room == 0 || drain(shell.out_fd, buffer, room);
+        size_t mark = buffer.find(needle);
+        size_t line_end = mark == std::string::npos ? std::string::npos : buffer.find('\n', mark + 1);
+        if (line_end != std::string::npos) {
+            // "\n<marker> <status> <cwd>"; anything after it is a background job's and is dropped
+            std::istringstream trailer(buffer.substr(mark + needle.size(), line_end - mark - needle.size()));
+            int code = 0;
+            trailer >> code;
+            std::getline(trailer >> std::ws, cwd);
+            result.status = (code & 0xff) << 8; // as waitpid reports an exit with this code
+            pending += buffer.substr(0, mark);
+            done = true;
+        } else if (buffer.size() > needle.size()) {
+            // Keep back what could be the start of the marker
+            size_t keep = mark == std::string::npos ? needle.size() : buffer.size() - mark;
+            pending += buffer.substr(0, buffer.size() - keep);
+            buffer.erase(0, buffer.size() - keep);
+        }
+        if (!done && (!open || childExited(shell))) {
+            pending += buffer;
+            shell_died = true;
+        }
+        if (!done && !shell_died && !lost_output) {
+            if (!shellLostOutput(shell)) {
+                lost_since = Clock::time_point::max();
+            } else if (lost_since == Clock::time_point::max()) {
+                lost_since = Clock::now();
+            } else if (Clock::now() - lost_since >= std::chrono::milliseconds(LOST_OUTPUT_GRACE_MS)) {
+                lost_output = true;
+                signalChild(shell, SIGKILL);
+            }
+        }
+
+        if (options.limits.max_output > 0 && result.output.totalBytes() + pending.size() > options.limits.max_output) {
+            pending.resize(pending.size() - std::min<unsigned long long>(
+                                                pending.size(), result.output.totalBytes() + pending.size() - options.limits.max_output));
+            if (!done && !shell_died && result.limit.empty()) kill_shell("output");
+        }
+        if (done || shell_died || Clock::now() - last_flush >= flush_interval) flush();
+    }
+
+    if (shell_died) {
+        if (!childExited(shell)) signalChild(shell, SIGKILL);
+        ResourceUsage usage;
+        std::string limit = result.limit;
+        reapChild(shell, limits, result.status, usage, limit);
+        if (!result.cancelled) result.limit = limit;
+        result.usage = usage;
+        result.usage.user_s = std::max(0.0, usage.user_s - user_before);
+        result.usage.system_s = std::max(0.0, usage.system_s - system_before);
+        result.usage.peak_rss_kb = result.usage.read_bytes = result.usage.written_bytes = 0;
+        close(shell.out_fd);
+        close(shell.in_fd);
+        shell = ChildProcess();
+    } else {
+        double user_after = 0, system_after = 0;
+        result.usage.valid = readCpuTimes(shell.pid, user_after, system_after);
+        result.usage.user_s = std::max(0.0, user_after - user_before);
+        result.usage.system_s = std::max(0.0, system_after - system_before);
+        // A command killed by RLIMIT_CPU shows up as 128 + SIGXCPU
+        if (options.limits.cpu_s > 0 && WEXITSTATUS(result.status) == 128 + SIGXCPU &&
+            result.usage.user_s + result.usage.system_s >= options.limits.cpu_s * 0.9) {
+            result.limit = "cpu";
+        }
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+    if (result.cancelled) {
+        result.output.append("\n[Command cancelled by user]");
+    } else if (!result.limit.empty()) {
+        result.output.append("\n[Command stopped: it exceeded " + describeLimit(result.limit, options.limits) + "]");
+    }
+    if (lost_output) {
+        result.output.append("\n[The command redirected the shell's output, so its end could not be seen. The shell was "
+                             "stopped; the next command starts a new one in " +
+                             (cwd.empty() ? std::string("the original directory") : cwd) +
+                             ", without the variables set before]");
+    } else if (shell_died) {
+        result.output.append("\n[The shell exited; the next command starts a new one in " +
+                             (cwd.empty() ? std::string("the original directory") : cwd) +
+                             ", without the variables set before]");
+    }
+    return finish();
+}
@@ -0,0 +1,354 @@
+#include "ori_jobs.h"
+#include "ori_exec.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+const size_t READ_SIZE = 64 * 1024;
+// Most a busy job may copy per round, so one chatty command cannot starve the rest
+const size_t MAX_COPY_PER_ROUND = 1024 * 1024;
+const int IDLE_TICK_MS = 1000;
+// Without a pidfd, or with a kill pending, exits are noticed by polling this often
+const int FALLBACK_TICK_MS = 100;
+const auto SWEEP_INTERVAL = std::chrono::seconds(30);
+const std::string LOG_PREFIX = "ori-exec-";
+
+std::filesystem::path logDir() {
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+    return ec ? std::filesystem::path("/tmp") : dir;
+}
+
+// Remove logs left behind by earlier servers once they are past retention
+void removeStaleLogs(int retention_s) {
+    std::error_code ec;
+    auto cutoff = std::filesystem::file_time_type::clock::now() - std::chrono::seconds(retention_s);
+    for (const auto& entry : std::filesystem::directory_iterator(logDir(), ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, LOG_PREFIX.size(), LOG_PREFIX) != 0) continue;
+        std::error_code entry_ec;
+        if (entry.last_write_time(entry_ec) < cutoff && !entry_ec) {
+            std::filesystem::remove(entry.path(), entry_ec);
+        }
+    }
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+// Copy what the pipe holds to the log, adding to `copied`; false once the pipe
+// is closed. Past `room` bytes the output is read and dropped, and `overflowed` set.
+bool pump(int from, int to, std::vector<char>& buffer, size_t& copied, size_t room, bool& overflowed) {
+    size_t this_round = 0;
+    while (this_round < MAX_COPY_PER_ROUND) {
+        ssize_t bytes_read = read(from, buffer.data(), buffer.size());
+        if (bytes_read > 0) {
+            size_t keep = std::min(static_cast<size_t>(bytes_read), room > copied ? room - copied : 0);
+            if (keep < static_cast<size_t>(bytes_read)) overflowed = true;
+            if (keep > 0 && writeAll(to, buffer.data(), keep)) copied += keep;
+            this_round += bytes_read;
+        } else if (bytes_read == 0) {
+            return false;
+        } else if (errno != EINTR) {
+            return true;
+        }
+    }
+    return true;
+}
+
+// Bytes at the end of `data` that begin a UTF-8 sequence still missing its continuation
+size_t incompleteUtf8Tail(const std::string& data) {
+    for (size_t back = 1; back <= 3 && back <= data.size(); ++back) {
+        unsigned char c = data[data.size() - back];
+        if ((c & 0xC0) == 0x80) continue;
+        size_t length = (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+        return length > back ? back : 0;
+    }
+    return 0;
+}
+}
+
+CommandJobs& CommandJobs::instance() {
+    static CommandJobs jobs;
+    return jobs;
+}
+
+CommandJobs::~CommandJobs() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    if (supervisor.joinable()) {
+        wake();
+        supervisor.join();
+    }
+    if (wake_fd[0] >= 0) close(wake_fd[0]);
+    if (wake_fd[1] >= 0) close(wake_fd[1]);
+}
+
+void CommandJobs::setRetention(int seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    retention_s = std::max(0, seconds);
+}
+
+void CommandJobs::setLimits(const ExecLimits& new_limits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    limits = new_limits;
+}
+
+bool CommandJobs::start(const std::string& command, std::string& id, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!supervisor.joinable()) {
+        if (pipe2(wake_fd, O_CLOEXEC | O_NONBLOCK) == -1) {
+            error = "Failed to create a pipe";
+            return false;
+        }
+        removeStaleLogs(retention_s);
+        supervisor = std::thread(&CommandJobs::supervise, this);
+    }
+
+    auto job = std::make_shared<Job>();
+    std::string job_id = std::to_string(next_id++);
+    job->command = command;
+    // The server's pid keeps two servers sharing the temp directory apart
+    job->log_path = (logDir() / (LOG_PREFIX + std::to_string(getpid()) + "-" + job_id + ".log")).string();
+    job->log_fd = open(job->log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (job->log_fd == -1) {
+        error = "Failed to create log file " + job->log_path;
+        return false;
+    }
+
+    job->limits = limits;
+    if (!spawnCommand(command, job->child, limits)) {
+        close(job->log_fd);
+        unlink(job->log_path.c_str());
+        error = "Failed to fork process";
+        return false;
+    }
+    job->started = Clock::now();
+    job->deadline = limits.timeout_s > 0 ? job->started + std::chrono::seconds(limits.timeout_s) : Clock::time_point::max();
+    jobs[job_id] = job;
+    running.fetch_add(1, std::memory_order_relaxed);
+    id = job_id;
+    wake();
+    return true;
+}
+
+void CommandJobs::wake() {
+    char byte = 1;
+    ssize_t ignored = write(wake_fd[1], &byte, 1);
+    (void)ignored;
+}
+
+void CommandJobs::supervise() {
+    std::vector<char> buffer(READ_SIZE);
+    auto last_sweep = Clock::now();
+    while (true) {
+        std::vector<pollfd> fds = {{wake_fd[0], POLLIN, 0}};
+        std::vector<std::shared_ptr<Job>> active;
+        int timeout_ms = IDLE_TICK_MS;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            for (const auto& entry : jobs) {
+                const Job& job = *entry.second;
+                if (!job.running) continue;
+                active.push_back(entry.second);
+                if (job.child.out_fd >= 0) fds.push_back({job.child.out_fd, POLLIN, 0});
+                if (job.child.pid_fd >= 0) fds.push_back({job.child.pid_fd, POLLIN, 0});
+                if (job.child.pid_fd < 0 || job.killed) timeout_ms = FALLBACK_TICK_MS;
+                if (job.deadline != Clock::time_point::max()) {
+                    auto until = std::chrono::duration_cast<std::chrono::milliseconds>(job.deadline - Clock::now());
+                    timeout_ms = std::max(0, std::min(timeout_ms, static_cast<int>(until.count()) + 1));
+                }
+            }
+        }
+        poll(fds.data(), fds.size(), timeout_ms);
+        char drained[64];
+        while (::read(wake_fd[0], drained, sizeof(drained)) > 0) {}
+
+        // Only this thread touches the pipes and log files, so the copying
+        // happens without the lock
+        for (const auto& job : active) {
+            size_t copied = 0;
+            bool overflowed = false;
+            // Only this thread changes log_bytes, so it can be read unlocked here
+            size_t room = job->limits.max_output > 0
+                              ? static_cast<size_t>(job->limits.max_output) - std::min<size_t>(job->log_bytes, job->limits.max_output)
+                              : SIZE_MAX;
+            bool pipe_open = job->child.out_fd >= 0 && pump(job->child.out_fd, job->log_fd, buffer, copied, room, overflowed);
+            // Look without reaping: the pid must stay ours until `running`
+            // is cleared, or kill() could signal a recycled process group
+            bool exited = childExited(job->child);
+            if (exited && pipe_open) {
+                // A background child may still hold the pipe; take what is there
+                pump(job->child.out_fd, job->log_fd, buffer, copied, room, overflowed);
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            job->log_bytes += copied;
+            if ((exited || !pipe_open) && job->child.out_fd >= 0) {
+                close(job->child.out_fd);
+                job->child.out_fd = -1;
+            }
+            if (!exited && job->limit.empty() && !job->killed) {
+                if (overflowed) job->limit = "output";
+                if (Clock::now() >= job->deadline) job->limit = "timeout";
+                if (!job->limit.empty()) signalChild(job->child, SIGKILL);
+            }
+            if (exited) {
+                reapChild(job->child, job->limits, job->status, job->usage, job->limit);
+                finishJob(*job);
+            } else if (job->killed && Clock::now() >= job->kill_deadline) {
+                signalChild(job->child, SIGKILL);
+                job->kill_deadline = Clock::time_point::max();
+            }
+            lock.unlock();
+            if (copied > 0 || exited) changed.notify_all();
+        }
+
+        if (Clock::now() - last_sweep >= SWEEP_INTERVAL) {
+            std::lock_guard<std::mutex> lock(mutex);
+            sweep();
+            last_sweep = Clock::now();
+        }
+    }
+}
+
+void CommandJobs::finishJob(Job& job) {
+    job.running = false;
+    job.finished = Clock::now();
+    job.seconds = std::chrono::duration<double>(job.finished - job.started).count();
+    if (job.child.out_fd >= 0) close(job.child.out_fd);
+    close(job.log_fd);
+    job.child.out_fd = job.log_fd = -1;
+    running.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CommandJobs::sweep() {
+    auto now = Clock::now();
+    std::vector<std::pair<Clock::time_point, std::string>> finished;
+    for (auto it = jobs.begin(); it != jobs.end();) {
+        const Job& job = *it->second;
+        if (!job.running && now - job.finished >= std::chrono::seconds(retention_s)) {
+            unlink(job.log_path.c_str());
+            it = jobs.erase(it);
+            continue;
+        }
+        if (!job.running) finished.push_back({job.finished, it->first});
+        ++it;
+    }
+    if (finished.size() <= MAX_FINISHED) return;
+    std::sort(finished.begin(), finished.end());
+    for (size_t i = 0; i + MAX_FINISHED < finished.size(); ++i) {
+        unlink(jobs[finished[i].second]->log_path.c_str());
+        jobs.erase(finished[i].second);
+    }
+}
+
+Json::Value CommandJobs::stateOf(const Job& job) const {
+    Json::Value state;
+    state["command"] = job.command;
+    state["status"] = job.running ? "running" : job.killed ? "killed" : "finished";
+    state["size"] = static_cast<Json::UInt64>(job.log_bytes);
+    double seconds = job.running ? std::chrono::duration<double>(Clock::now() - job.started).count() : job.seconds;
+    state["duration_ms"] = static_cast<Json::Int64>(seconds * 1000);
+    if (!job.running) {
+        if (WIFEXITED(job.status)) state["exit_code"] = WEXITSTATUS(job.status);
+        if (WIFSIGNALED(job.status)) state["signal"] = WTERMSIG(job.status);
+        if (job.usage.valid) {
+            Json::Value usage;
+            usage["user_s"] = job.usage.user_s;
+            usage["system_s"] = job.usage.system_s;
+            usage["peak_rss_kb"] = static_cast<Json::Int64>(job.usage.peak_rss_kb);
+            usage["read_bytes"] = static_cast<Json::Int64>(job.usage.read_bytes);
+            usage["written_bytes"] = static_cast<Json::Int64>(job.usage.written_bytes);
+            usage["summary"] = job.usage.summary();
+            state["usage"] = usage;
+        }
+        if (!job.limit.empty()) {
+            state["limit"] = job.limit;
+            state["limit_text"] = describeLimit(job.limit, job.limits);
+        }
+    }
+    return state;
+}
+
+bool CommandJobs::read(const std::string& id, size_t offset, size_t max_bytes, std::string& data, Json::Value& state) {
+    std::string log_path;
+    size_t log_bytes;
+    bool running_now;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        if (it == jobs.end()) return false;
+        state = stateOf(*it->second);
+        log_path = it->second->log_path;
+        log_bytes = it->second->log_bytes;
+        running_now = it->second->running;
+    }
+
+    offset = std::min(offset, log_bytes);
+    size_t length = std::min(max_bytes, log_bytes - offset);
+    data.assign(length, '\0');
+    int fd = open(log_path.c_str(), O_RDONLY | O_CLOEXEC);
+    ssize_t got = fd == -1 ? 0 : pread(fd, &data[0], length, static_cast<off_t>(offset));
+    if (fd != -1) close(fd);
+    data.resize(got > 0 ? static_cast<size_t>(got) : 0);
+    // Leave a split multi-byte character for the next read
+    if (running_now || offset + data.size() < log_bytes) data.resize(data.size() - incompleteUtf8Tail(data));
+    state["offset"] = static_cast<Json::UInt64>(offset + data.size());
+    return true;
+}
+
+bool CommandJobs::waitForOutput(const std::map<std::string, size_t>& seen, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto ready = [this, &seen]() {
+        for (const auto& entry : seen) {
+            auto it = jobs.find(entry.first);
+            if (it == jobs.end() || it->second->log_bytes > entry.second || !it->second->running) return true;
+        }
+        return false;
+    };
+    changed.wait_for(lock, timeout, ready);
+    for (const auto& entry : seen) {
+        if (jobs.count(entry.first) > 0) return true;
+    }
+    return false;
+}
+
+bool CommandJobs::kill(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(id);
+    if (it == jobs.end() || !it->second->running) return false;
+    Job& job = *it->second;
+    if (!job.killed) {
+        ::kill(-job.child.pid, SIGTERM);
+        job.killed = true;
+        job.kill_deadline = Clock::now() + std::chrono::milliseconds(KILL_GRACE_MS);
+        wake();
+    }
+    return true;
+}
+
+long long CommandJobs::runningCount() const {
+    return running.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,110 @@
+#include "ori_metrics.h"
+#include "ori_net.h"
+#include <cstdio>
+
+namespace {
+const double BUCKET_BOUNDS[LatencyHistogram::BUCKETS] = {
+    0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120};
+
+std::string number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+    return buffer;
+}
+
+void sample(std::string& out, const std::string& name, const std::string& labels, unsigned long long value) {
+    out += name;
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += " " + std::to_string(value) + "\n";
+}
+}
+
+void LatencyHistogram::observe(double seconds) {
+    if (seconds < 0) seconds = 0;
+    size_t bucket = 0;
+    while (bucket < BUCKETS && seconds > BUCKET_BOUNDS[bucket]) bucket++;
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(static_cast<unsigned long long>(seconds * 1e6), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::render(std::string& out, const std::string& name, const std::string& labels) const {
+    const std::string prefix = labels.empty() ? "" : labels + ",";
+    unsigned long long cumulative = 0;
+    for (size_t i = 0; i <= BUCKETS; ++i) {
+        cumulative += counts[i].load(std::memory_order_relaxed);
+        std::string le = i < BUCKETS ? number(BUCKET_BOUNDS[i]) : "+Inf";
+        sample(out, name + "_bucket", prefix + "le=\"" + le + "\"", cumulative);
+    }
+    out += name + "_sum";
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += " " + number(sum_us.load(std::memory_order_relaxed) / 1e6) + "\n";
+    // Buckets and count are read separately; keep _count consistent with +Inf
+    sample(out, name + "_count", labels, cumulative);
+}
+
+MetricFamily<UpstreamMetrics>& upstreamMetrics() {
+    static MetricFamily<UpstreamMetrics> family;
+    return family;
+}
+
+std::string metricLabel(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void metricHeader(std::string& out, const char* name, const char* type, const char* help) {
+    out += std::string("# HELP ") + name + " " + help + "\n";
+    out += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+void renderProcessMetrics(std::string& out) {
+    MetricFamily<UpstreamMetrics>& upstream = upstreamMetrics();
+
+    metricHeader(out, "ori_upstream_requests_total", "counter", "Chat transfers to the API by model and outcome.");
+    upstream.forEach([&out](const std::string& model, const UpstreamMetrics& m) {
+        const std::string label = "model=\"" + metricLabel(model) + "\",outcome=";
+        sample(out, "ori_upstream_requests_total", label + "\"ok\"", m.ok.load());
+        sample(out, "ori_upstream_requests_total", label + "\"http_error\"", m.http_errors.load());
+        sample(out, "ori_upstream_requests_total", label + "\"transport_error\"", m.transport_errors.load());
+        sample(out, "ori_upstream_requests_total", label + "\"cancelled\"", m.cancelled.load());
+    });
+    metricHeader(out, "ori_upstream_retries_total", "counter", "Chat requests retried after 429, 5xx or transport errors.");
+    upstream.forEach([&out](const std::string& model, const UpstreamMetrics& m) {
+        sample(out, "ori_upstream_retries_total", "model=\"" + metricLabel(model) + "\"", m.retries.load());
+    });
+    metricHeader(out, "ori_upstream_request_duration_seconds", "histogram", "Duration of chat transfers to the API.");
+    upstream.forEach([&out](const std::string& model, const UpstreamMetrics& m) {
+        m.duration.render(out, "ori_upstream_request_duration_seconds", "model=\"" + metricLabel(model) + "\"");
+    });
+    metricHeader(out, "ori_upstream_first_byte_seconds", "histogram", "Time from sending a chat request to the first response byte.");
+    upstream.forEach([&out](const std::string& model, const UpstreamMetrics& m) {
+        m.first_byte.render(out, "ori_upstream_first_byte_seconds", "model=\"" + metricLabel(model) + "\"");
+    });
+    metricHeader(out, "ori_upstream_tokens_total", "counter", "Tokens reported in replies' usage, by model and kind.");
+    upstream.forEach([&out](const std::string& model, const UpstreamMetrics& m) {
+        const std::string label = "model=\"" + metricLabel(model) + "\",kind=";
+        sample(out, "ori_upstream_tokens_total", label + "\"prompt\"", m.prompt_tokens.load());
+        sample(out, "ori_upstream_tokens_total", label + "\"cached_prompt\"", m.cached_tokens.load());
+        sample(out, "ori_upstream_tokens_total", label + "\"completion\"", m.completion_tokens.load());
+    });
+
+    Json::Value transfer = TransferCounters::instance().snapshot();
+    metricHeader(out, "ori_upstream_bytes_total", "counter", "Chat request and response bytes, before (logical) and after (wire) Content-Encoding.");
+    for (const char* direction : {"upload", "download"}) {
+        const std::string label = std::string("direction=\"") + direction + "\",layer=";
+        sample(out, "ori_upstream_bytes_total", label + "\"logical\"", transfer[direction]["logical_bytes"].asUInt64());
+        sample(out, "ori_upstream_bytes_total", label + "\"wire\"", transfer[direction]["wire_bytes"].asUInt64());
+    }
+}
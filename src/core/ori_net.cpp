@@ -0,0 +1,339 @@
+#include "ori_net.h"
+#include <iostream>
+#include <cstdlib>
+
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
+namespace {
+// Keep at most this many idle handles around; extra ones are cleaned up.
+const size_t MAX_IDLE_HANDLES = 8;
+// A connection used within this window is assumed to still be alive.
+const long long PREWARM_IDLE_MS = 20000;
+
+long long now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef CURL_FOUND
+size_t discard_body(void*, size_t size, size_t nmemb, void*) {
+    return size * nmemb;
+}
+#endif
+}
+
+ConnectionPool& ConnectionPool::instance() {
+    static ConnectionPool pool;
+    return pool;
+}
+
+ConnectionPool::ConnectionPool() {
+#ifdef CURL_FOUND
+    // Hold our own reference on libcurl so pooled handles outlive any OriAssistant.
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    share = curl_share_init();
+    if (share) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 // 7.57.0: shared connection cache
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
+#endif
+}
+
+ConnectionPool::~ConnectionPool() {
+#ifdef CURL_FOUND
+    for (CURL* handle : idle_handles) {
+        curl_easy_cleanup(handle);
+    }
+    idle_handles.clear();
+    if (share) {
+        curl_share_cleanup(share);
+        share = nullptr;
+    }
+    curl_global_cleanup();
+#endif
+}
+
+void ConnectionPool::touch() {
+    last_used_ms = now_ms();
+}
+
+#ifdef CURL_FOUND
+void ConnectionPool::lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<ConnectionPool*>(userptr)->share_locks[data].lock();
+}
+
+void ConnectionPool::unlockShare(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<ConnectionPool*>(userptr)->share_locks[data].unlock();
+}
+
+CURL* ConnectionPool::acquire() {
+    CURL* handle = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (!idle_handles.empty()) {
+            handle = idle_handles.back();
+            idle_handles.pop_back();
+        }
+    }
+    if (!handle) {
+        handle = curl_easy_init();
+        if (!handle) return nullptr;
+    }
+
+    // Options are wiped by curl_easy_reset() on release, so apply them every time.
+    if (share) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, share);
+    }
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    // Offer every encoding this libcurl can decode (gzip, br, zstd); the
+    // write callbacks still see plain bytes.
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+    touch();
+    return handle;
+}
+
+void ConnectionPool::release(CURL* handle) {
+    if (!handle) return;
+    touch();
+    // curl_easy_reset keeps live connections, the DNS cache and TLS sessions.
+    curl_easy_reset(handle);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (idle_handles.size() < MAX_IDLE_HANDLES) {
+        idle_handles.push_back(handle);
+    } else {
+        curl_easy_cleanup(handle);
+    }
+}
+#endif
+
+void ConnectionPool::prewarm(const std::string& url, const std::string& unix_socket) {
+#ifdef CURL_FOUND
+    if (now_ms() - last_used_ms < PREWARM_IDLE_MS) return;
+
+    bool expected = false;
+    if (!prewarm_running.compare_exchange_strong(expected, true)) return;
+
+    CURL* handle = acquire();
+    if (!handle) {
+        prewarm_running = false;
+        return;
+    }
+    // A HEAD request is enough to resolve, connect and finish the TLS
+    // handshake; the connection then lands in the shared cache.
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    if (!unix_socket.empty()) {
+        curl_easy_setopt(handle, CURLOPT_UNIX_SOCKET_PATH, unix_socket.c_str());
+    }
+    curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, discard_body);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, 5L);
+    curl_easy_setopt(handle, CURLOPT_USERAGENT, "OriAssistant/1.0");
+
+    NetworkLoop& loop = NetworkLoop::instance();
+    loop.post([this, handle, &loop]() {
+        loop.start(handle, [this, handle](CURLcode res) {
+            const char* debug_env = std::getenv("ORI_DEBUG");
+            if (debug_env && std::string(debug_env) == "1") {
+                std::cerr << "[ORI_DEBUG] Connection pre-warm: " << curl_easy_strerror(res) << std::endl;
+            }
+            release(handle);
+            prewarm_running = false;
+        });
+    });
+#else
+    (void)url;
+    (void)unix_socket;
+#endif
+}
+
+#ifdef CURL_FOUND
+NetworkLoop& NetworkLoop::instance() {
+    static NetworkLoop loop;
+    return loop;
+}
+
+NetworkLoop::NetworkLoop() {
+    // Handles come from the pool; make sure it is destroyed after the loop.
+    ConnectionPool::instance();
+    multi = curl_multi_init();
+    thread = std::thread(&NetworkLoop::run, this);
+}
+
+NetworkLoop::~NetworkLoop() {
+    stopping = true;
+    curl_multi_wakeup(multi);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    for (auto& transfer : active) {
+        curl_multi_remove_handle(multi, transfer.first);
+    }
+    active.clear();
+    curl_multi_cleanup(multi);
+}
+
+void NetworkLoop::post(Task task, long delay_ms) {
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        tasks.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms), std::move(task));
+    }
+    curl_multi_wakeup(multi);
+}
+
+void NetworkLoop::start(CURL* handle, DoneCallback on_done) {
+    active[handle] = std::move(on_done);
+    curl_multi_add_handle(multi, handle);
+}
+
+void NetworkLoop::abort(CURL* handle) {
+    if (active.erase(handle)) {
+        curl_multi_remove_handle(multi, handle);
+    }
+}
+
+void NetworkLoop::run() {
+    while (!stopping) {
+        // Run every task that is due
+        auto now = std::chrono::steady_clock::now();
+        long poll_ms = 1000;
+        while (true) {
+            Task task;
+            {
+                std::lock_guard<std::mutex> lock(task_mutex);
+                if (tasks.empty()) break;
+                auto next = tasks.begin();
+                if (next->first > now) {
+                    poll_ms = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                        next->first - now).count()) + 1;
+                    break;
+                }
+                task = std::move(next->second);
+                tasks.erase(next);
+            }
+            task();
+        }
+
+        int still_running = 0;
+        curl_multi_perform(multi, &still_running);
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL* handle = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            curl_multi_remove_handle(multi, handle);
+            auto it = active.find(handle);
+            if (it == active.end()) continue;
+            DoneCallback on_done = std::move(it->second);
+            active.erase(it);
+            on_done(result);
+        }
+
+        curl_multi_poll(multi, nullptr, 0, static_cast<int>(std::min(poll_ms, 1000L)), nullptr);
+    }
+}
+#endif
+
+TransferCounters& TransferCounters::instance() {
+    static TransferCounters counters;
+    return counters;
+}
+
+void TransferCounters::addUpload(unsigned long long logical, unsigned long long wire) {
+    uploads.fetch_add(1, std::memory_order_relaxed);
+    upload_logical.fetch_add(logical, std::memory_order_relaxed);
+    upload_wire.fetch_add(wire, std::memory_order_relaxed);
+}
+
+void TransferCounters::addDownload(unsigned long long logical, unsigned long long wire) {
+    downloads.fetch_add(1, std::memory_order_relaxed);
+    download_logical.fetch_add(logical, std::memory_order_relaxed);
+    download_wire.fetch_add(wire, std::memory_order_relaxed);
+}
+
+Json::Value TransferCounters::snapshot() const {
+    auto direction = [](unsigned long long count, unsigned long long logical, unsigned long long wire) {
+        Json::Value item;
+        item["transfers"] = static_cast<Json::UInt64>(count);
+        item["logical_bytes"] = static_cast<Json::UInt64>(logical);
+        item["wire_bytes"] = static_cast<Json::UInt64>(wire);
+        item["saved_bytes"] = static_cast<Json::Int64>(logical) - static_cast<Json::Int64>(wire);
+        return item;
+    };
+    Json::Value root;
+    root["upload"] = direction(uploads.load(), upload_logical.load(), upload_wire.load());
+    root["download"] = direction(downloads.load(), download_logical.load(), download_wire.load());
+    return root;
+}
+
+PromptCacheCounters& PromptCacheCounters::instance() {
+    static PromptCacheCounters counters;
+    return counters;
+}
+
+void PromptCacheCounters::add(long long prompt, long long cached) {
+    replies.fetch_add(1, std::memory_order_relaxed);
+    if (cached > 0) replies_with_hits.fetch_add(1, std::memory_order_relaxed);
+    prompt_tokens.fetch_add(prompt > 0 ? prompt : 0, std::memory_order_relaxed);
+    cached_tokens.fetch_add(cached > 0 ? cached : 0, std::memory_order_relaxed);
+}
+
+Json::Value PromptCacheCounters::snapshot() const {
+    Json::Value root;
+    const unsigned long long prompt = prompt_tokens.load();
+    const unsigned long long cached = cached_tokens.load();
+    root["replies"] = static_cast<Json::UInt64>(replies.load());
+    root["replies_with_hits"] = static_cast<Json::UInt64>(replies_with_hits.load());
+    root["prompt_tokens"] = static_cast<Json::UInt64>(prompt);
+    root["cached_tokens"] = static_cast<Json::UInt64>(cached);
+    root["hit_ratio"] = prompt > 0 ? static_cast<double>(cached) / prompt : 0.0;
+    return root;
+}
+
+bool gzipRequestBody(const RequestBody& body, RequestBody& out) {
+#ifdef ZLIB_FOUND
+    z_stream stream{};
+    // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    std::string compressed;
+    compressed.resize(deflateBound(&stream, body.size()) + 64);
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    const auto& parts = body.parts();
+    int status = Z_OK;
+    for (size_t i = 0; i < parts.size() && status == Z_OK; ++i) {
+        const bool last = i + 1 == parts.size();
+        if (parts[i]->empty() && !last) continue;
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(parts[i]->data()));
+        stream.avail_in = static_cast<uInt>(parts[i]->size());
+        status = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+    }
+    if (parts.empty()) status = deflate(&stream, Z_FINISH);
+    size_t written = stream.total_out;
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) return false;
+
+    compressed.resize(written);
+    out = RequestBody();
+    out.append(std::move(compressed));
+    return true;
+#else
+    (void)body;
+    (void)out;
+    return false;
+#endif
+}
@@ -0,0 +1,257 @@
+#include "ori_output.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+
+namespace {
+const std::string SPILL_PREFIX = "ori-output-";
+
+std::filesystem::path spillDir() {
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+    return ec ? std::filesystem::path("/tmp") : dir;
+}
+
+// Spill files this process wrote; the model may still open them while the
+// session runs, so they go when it exits
+struct SpillFiles {
+    std::mutex mutex;
+    std::vector<std::string> paths;
+
+    ~SpillFiles() {
+        for (const auto& path : paths) unlink(path.c_str());
+    }
+};
+
+SpillFiles& spillFiles() {
+    static SpillFiles files;
+    return files;
+}
+
+struct Compaction {
+    unsigned long long escapes = 0;
+    unsigned long long redraws = 0;
+    unsigned long long folded = 0;
+};
+
+std::string stripAnsi(const std::string& in, Compaction& stats) {
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        if (in[i] != '\x1b') {
+            out += in[i];
+            continue;
+        }
+        stats.escapes++;
+        if (i + 1 >= in.size()) break;
+        char kind = in[++i];
+        if (kind == '[') {
+            // CSI: parameters, then one final byte in 0x40-0x7e
+            while (i + 1 < in.size() && !(in[i + 1] >= 0x40 && in[i + 1] <= 0x7e)) ++i;
+            ++i;
+        } else if (kind == ']') {
+            // OSC: ends with BEL or ESC backslash
+            while (i + 1 < in.size() && in[i + 1] != '\a' && in[i + 1] != '\x1b') ++i;
+            ++i;
+            if (i < in.size() && in[i] == '\x1b') ++i;
+        }
+    }
+    return out;
+}
+
+// Split into lines, each reduced to what a terminal would show last
+std::vector<std::string> splitLines(const std::string& text, Compaction& stats) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t redraw = line.rfind('\r');
+        if (redraw != std::string::npos) {
+            stats.redraws += std::count(line.begin(), line.end(), '\r');
+            line.erase(0, redraw + 1);
+        }
+        lines.push_back(std::move(line));
+        start = end + 1;
+    }
+    return lines;
+}
+
+void foldRepeats(std::vector<std::string>& lines, Compaction& stats) {
+    std::vector<std::string> out;
+    size_t i = 0;
+    while (i < lines.size()) {
+        size_t j = i;
+        while (j < lines.size() && lines[j] == lines[i]) ++j;
+        size_t run = j - i;
+        if (run >= 3) {
+            out.push_back(lines[i]);
+            out.push_back("[previous line repeated " + std::to_string(run - 1) + " more times]");
+            stats.folded += run - 1;
+        } else {
+            out.insert(out.end(), lines.begin() + i, lines.begin() + j);
+        }
+        i = j;
+    }
+    lines.swap(out);
+}
+
+unsigned long long lineBytes(std::vector<std::string>::const_iterator from, std::vector<std::string>::const_iterator to) {
+    unsigned long long bytes = 0;
+    for (; from != to; ++from) bytes += from->size() + 1;
+    return bytes;
+}
+
+std::string joinLines(const std::vector<std::string>& lines) {
+    std::string out;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (i > 0) out += '\n';
+        out += lines[i];
+    }
+    return out;
+}
+}
+
+OutputCapture::OutputCapture(size_t max_bytes) : max_bytes(max_bytes) {}
+
+void OutputCapture::append(const std::string& data) {
+    total_bytes += data.size();
+    total_lines += std::count(data.begin(), data.end(), '\n');
+    if (spill_file) std::fwrite(data.data(), 1, data.size(), spill_file.get());
+    if (max_bytes == 0) {
+        head_text += data;
+        return;
+    }
+
+    size_t head_max = max_bytes / 2;
+    size_t to_head = head_text.size() < head_max ? std::min(head_max - head_text.size(), data.size()) : 0;
+    head_text.append(data, 0, to_head);
+    tail_text.append(data, to_head, std::string::npos);
+
+    size_t tail_max = max_bytes - head_max;
+    if (tail_text.size() > tail_max) {
+        if (!truncated()) spill(head_text + tail_text);
+        size_t excess = tail_text.size() - tail_max;
+        tail_text.erase(0, excess);
+        dropped_bytes += excess;
+    }
+}
+
+void OutputCapture::spill(const std::string& data) {
+    // The pid tells a later sweep whether the session that wrote it is still running
+    std::string path = (spillDir() / (SPILL_PREFIX + std::to_string(getpid()) + "-XXXXXX.log")).string();
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = mkstemps(name.data(), 4);
+    if (fd == -1) return;
+    FILE* file = fdopen(fd, "w");
+    if (!file) return;
+    spill_file.reset(file, std::fclose);
+    spill_path = name.data();
+    std::fwrite(data.data(), 1, data.size(), file);
+    SpillFiles& files = spillFiles();
+    std::lock_guard<std::mutex> lock(files.mutex);
+    files.paths.push_back(spill_path);
+}
+
+void removeStaleSpillFiles(int retention_s) {
+    std::error_code ec;
+    auto cutoff = std::filesystem::file_time_type::clock::now() - std::chrono::seconds(retention_s);
+    for (const auto& entry : std::filesystem::directory_iterator(spillDir(), ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, SPILL_PREFIX.size(), SPILL_PREFIX) != 0) continue;
+        // "ori-output-<pid>-XXXXXX.log": leave a live session's files alone
+        pid_t pid = static_cast<pid_t>(std::strtol(name.c_str() + SPILL_PREFIX.size(), nullptr, 10));
+        if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) continue;
+        std::error_code entry_ec;
+        if (entry.last_write_time(entry_ec) < cutoff && !entry_ec) {
+            std::filesystem::remove(entry.path(), entry_ec);
+        }
+    }
+}
+
+void OutputCapture::finish() {
+    spill_file.reset();
+}
+
+unsigned long long OutputCapture::droppedLines() const {
+    return total_lines - std::count(head_text.begin(), head_text.end(), '\n') -
+           std::count(tail_text.begin(), tail_text.end(), '\n');
+}
+
+std::string OutputCapture::text() const {
+    if (!truncated()) return head_text + tail_text;
+    return head_text + "\n[... " + std::to_string(dropped_bytes) + " bytes omitted ...]\n" + tail_text;
+}
+
+std::string compactOutput(const OutputCapture& capture, size_t max_lines) {
+    Compaction stats;
+    std::vector<std::string> head_lines = splitLines(stripAnsi(capture.head(), stats), stats);
+    std::vector<std::string> tail_lines;
+    unsigned long long omitted_lines = 0;
+    unsigned long long omitted_bytes = 0;
+
+    if (capture.truncated()) {
+        // The tail starts in the middle of a line; count that fragment as omitted
+        std::string tail = capture.tail();
+        size_t first_newline = tail.find('\n');
+        size_t fragment = first_newline == std::string::npos ? tail.size() : first_newline + 1;
+        omitted_bytes += capture.droppedBytes() + fragment;
+        omitted_lines += capture.droppedLines() + (first_newline == std::string::npos ? 0 : 1);
+        tail_lines = splitLines(stripAnsi(tail.substr(fragment), stats), stats);
+    }
+    foldRepeats(head_lines, stats);
+    foldRepeats(tail_lines, stats);
+
+    if (max_lines > 0 && head_lines.size() + tail_lines.size() > max_lines) {
+        if (tail_lines.empty()) {
+            size_t keep_tail = max_lines / 2;
+            tail_lines.assign(head_lines.end() - keep_tail, head_lines.end());
+            head_lines.erase(head_lines.end() - keep_tail, head_lines.end());
+        }
+        size_t keep_head = std::min(head_lines.size(), (max_lines + 1) / 2);
+        size_t keep_tail = std::min(tail_lines.size(), max_lines - keep_head);
+        keep_head = std::min(head_lines.size(), max_lines - keep_tail);
+
+        omitted_lines += head_lines.size() - keep_head + tail_lines.size() - keep_tail;
+        omitted_bytes += lineBytes(head_lines.begin() + keep_head, head_lines.end()) +
+                         lineBytes(tail_lines.begin(), tail_lines.end() - keep_tail);
+        head_lines.resize(keep_head);
+        tail_lines.erase(tail_lines.begin(), tail_lines.end() - keep_tail);
+    }
+
+    std::string out = joinLines(head_lines);
+    if (omitted_lines > 0 || omitted_bytes > 0) {
+        if (!out.empty()) out += '\n';
+        out += "[... " + std::to_string(omitted_lines) + " lines (" + std::to_string(omitted_bytes) +
+               " bytes) omitted here ...]";
+    }
+    if (!tail_lines.empty()) {
+        if (!out.empty()) out += '\n';
+        out += joinLines(tail_lines);
+    }
+
+    if (capture.truncated()) {
+        out += "\n[The full output was " + std::to_string(capture.totalBytes()) + " bytes in " +
+               std::to_string(capture.totalLines()) + " lines";
+        out += capture.spillPath().empty() ? "; it could not be saved]" : " and is saved in " + capture.spillPath() + "]";
+    }
+    if (stats.escapes > 0 || stats.redraws > 0 || stats.folded > 0) {
+        std::vector<std::string> parts;
+        if (stats.escapes > 0) parts.push_back("removed " + std::to_string(stats.escapes) + " ANSI escape sequences");
+        if (stats.redraws > 0) parts.push_back("dropped " + std::to_string(stats.redraws) + " carriage-return redraws");
+        if (stats.folded > 0) parts.push_back("folded " + std::to_string(stats.folded) + " repeated lines");
+        std::string note;
+        for (size_t i = 0; i < parts.size(); ++i) note += (i > 0 ? ", " : "") + parts[i];
+        out += "\n[Output compacted: " + note + "]";
+    }
+    return out;
+}
@@ -0,0 +1,297 @@
+#include "ori_protocol.h"
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <cctype>
+
+#ifdef CURL_FOUND
+#include <curl/curl.h>
+#else
+#define CURL_SEEKFUNC_OK 0
+#define CURL_SEEKFUNC_CANTSEEK 2
+#endif
+
+const char* chatRoleName(ChatRole role) {
+    switch (role) {
+        case ChatRole::System: return "system";
+        case ChatRole::User: return "user";
+        case ChatRole::Assistant: return "assistant";
+    }
+    return "user";
+}
+
+// Length of the well-formed UTF-8 sequence starting at p, or 0 if it is not
+// one (stray continuation bytes, overlongs, surrogates, truncation).
+static size_t utf8SequenceLength(const unsigned char* p, size_t remaining) {
+    unsigned char c = p[0];
+    size_t len;
+    if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) len = 3;
+    else if (c >= 0xF0 && c <= 0xF4) len = 4;
+    else return 0;
+    if (remaining < len) return 0;
+    for (size_t i = 1; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    if (c == 0xE0 && p[1] < 0xA0) return 0;
+    if (c == 0xED && p[1] > 0x9F) return 0;
+    if (c == 0xF0 && p[1] < 0x90) return 0;
+    if (c == 0xF4 && p[1] > 0x8F) return 0;
+    return len;
+}
+
+void appendJsonString(std::string& out, const std::string& text) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t n = text.size();
+
+    out.reserve(out.size() + n + 2);
+    out += '"';
+    size_t run_start = 0;
+    size_t i = 0;
+    while (i < n) {
+        unsigned char c = s[i];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+            i++;
+            continue;
+        }
+        if (c >= 0x80) {
+            size_t len = utf8SequenceLength(s + i, n - i);
+            if (len) {
+                i += len;
+                continue;
+            }
+        }
+
+        // Copy the clean run in one go, then emit the escape
+        out.append(text, run_start, i - run_start);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                } else {
+                    out += "\\ufffd";
+                }
+        }
+        i++;
+        run_start = i;
+    }
+    out.append(text, run_start, n - run_start);
+    out += '"';
+}
+
+void RequestBody::append(std::string text) {
+    append(std::make_shared<const std::string>(std::move(text)));
+}
+
+void RequestBody::append(std::shared_ptr<const std::string> chunk) {
+    total += chunk->size();
+    chunks.push_back(std::move(chunk));
+}
+
+std::string RequestBody::str() const {
+    std::string flat;
+    flat.reserve(total);
+    for (const auto& chunk : chunks) flat += *chunk;
+    return flat;
+}
+
+void RequestBody::rewind() {
+    chunk_index = 0;
+    chunk_offset = 0;
+}
+
+size_t RequestBody::read(char* buffer, size_t size, size_t nitems, void* userdata) {
+    RequestBody* body = static_cast<RequestBody*>(userdata);
+    size_t capacity = size * nitems;
+    size_t written = 0;
+    while (written < capacity && body->chunk_index < body->chunks.size()) {
+        const std::string& chunk = *body->chunks[body->chunk_index];
+        size_t n = std::min(capacity - written, chunk.size() - body->chunk_offset);
+        std::memcpy(buffer + written, chunk.data() + body->chunk_offset, n);
+        written += n;
+        body->chunk_offset += n;
+        if (body->chunk_offset == chunk.size()) {
+            body->chunk_index++;
+            body->chunk_offset = 0;
+        }
+    }
+    return written;
+}
+
+int RequestBody::seek(void* userdata, long long offset, int origin) {
+    RequestBody* body = static_cast<RequestBody*>(userdata);
+    if (origin != SEEK_SET || offset < 0 || static_cast<size_t>(offset) > body->total) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    body->rewind();
+    size_t remaining = static_cast<size_t>(offset);
+    while (remaining > 0 && body->chunk_index < body->chunks.size()) {
+        size_t chunk_size = body->chunks[body->chunk_index]->size();
+        if (remaining < chunk_size) {
+            body->chunk_offset = remaining;
+            break;
+        }
+        remaining -= chunk_size;
+        body->chunk_index++;
+    }
+    return CURL_SEEKFUNC_OK;
+}
+
+void HistorySerializer::sync(const std::vector<ChatMessage>& history, bool cache_hints) {
+    if (cache_hints != hints) {
+        entries.clear();
+        hints = cache_hints;
+    }
+    if (entries.size() > history.size()) {
+        entries.resize(history.size());
+    }
+    entries.reserve(history.size());
+    for (size_t i = entries.size(); i < history.size(); ++i) {
+        const ChatMessage& msg = history[i];
+        auto json = std::make_shared<std::string>();
+        json->reserve(msg.content.size() + 48);
+        if (i > 0) *json += ',';
+        *json += "{\"role\":\"";
+        *json += chatRoleName(msg.role);
+        *json += "\",\"content\":";
+        if (hints && msg.cache_breakpoint) {
+            *json += "[{\"type\":\"text\",\"text\":";
+            appendJsonString(*json, msg.content);
+            *json += ",\"cache_control\":{\"type\":\"ephemeral\"}}]";
+        } else {
+            appendJsonString(*json, msg.content);
+        }
+        *json += '}';
+        entries.push_back(std::move(json));
+    }
+}
+
+void HistorySerializer::invalidateFrom(size_t index) {
+    if (index < entries.size()) {
+        entries.resize(index);
+    }
+}
+
+void HistorySerializer::appendTo(RequestBody& body) const {
+    for (const auto& entry : entries) {
+        body.append(entry);
+    }
+}
+
+bool modelTakesCacheHints(const std::string& model) {
+    std::string name = model;
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name.find("claude") != std::string::npos || name.find("anthropic/") != std::string::npos ||
+           name.find("gemini") != std::string::npos;
+}
+
+bool promptTokenUsage(const Json::Value& usage, long long& prompt_tokens, long long& cached_tokens) {
+    if (!usage.isObject()) return false;
+    cached_tokens = 0;
+    if (usage["prompt_tokens"].isIntegral()) {
+        // OpenAI and OpenRouter; DeepSeek reports its hits separately
+        prompt_tokens = usage["prompt_tokens"].asInt64();
+        const Json::Value& details = usage["prompt_tokens_details"];
+        if (details.isObject() && details["cached_tokens"].isIntegral()) {
+            cached_tokens = details["cached_tokens"].asInt64();
+        } else if (usage["prompt_cache_hit_tokens"].isIntegral()) {
+            cached_tokens = usage["prompt_cache_hit_tokens"].asInt64();
+        }
+        return true;
+    }
+    if (usage["input_tokens"].isIntegral()) {
+        // Anthropic counts cache reads and writes apart from input_tokens
+        cached_tokens = usage.get("cache_read_input_tokens", 0).asInt64();
+        prompt_tokens = usage["input_tokens"].asInt64() + cached_tokens +
+                        usage.get("cache_creation_input_tokens", 0).asInt64();
+        return true;
+    }
+    return false;
+}
+
+SseParser::SseParser(TokenCallback on_token) : on_token(std::move(on_token)) {}
+
+void SseParser::reset() {
+    line_buffer.clear();
+    content.clear();
+    raw_body.clear();
+    error_obj = Json::Value();
+    usage_obj = Json::Value();
+    saw_events = false;
+    done = false;
+}
+
+void SseParser::feed(const char* data, size_t len) {
+    // Until the first event arrives we cannot tell SSE from a plain JSON
+    // error body, so keep the raw bytes around for the error path.
+    if (!saw_events) {
+        raw_body.append(data, len);
+    }
+
+    line_buffer.append(data, len);
+    size_t start = 0;
+    size_t newline;
+    while ((newline = line_buffer.find('\n', start)) != std::string::npos) {
+        size_t end = newline;
+        if (end > start && line_buffer[end - 1] == '\r') end--;
+        handleLine(line_buffer.substr(start, end - start));
+        start = newline + 1;
+    }
+    line_buffer.erase(0, start);
+}
+
+void SseParser::handleLine(const std::string& line) {
+    // Blank lines separate events; lines starting with ':' are keep-alive
+    // comments (OpenRouter sends ": OPENROUTER PROCESSING" while queued).
+    if (line.empty() || line[0] == ':') return;
+    if (line.compare(0, 5, "data:") != 0) return;
+
+    size_t payload_start = 5;
+    if (payload_start < line.size() && line[payload_start] == ' ') payload_start++;
+    if (line.compare(payload_start, std::string::npos, "[DONE]") == 0) {
+        done = true;
+        return;
+    }
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value chunk;
+    std::string errs;
+    const char* begin = line.data() + payload_start;
+    if (!reader->parse(begin, line.data() + line.size(), &chunk, &errs)) return;
+
+    if (!saw_events) {
+        saw_events = true;
+        raw_body.clear();
+        raw_body.shrink_to_fit();
+    }
+
+    if (chunk.isMember("error")) {
+        error_obj = chunk["error"];
+        return;
+    }
+    if (chunk.isMember("usage") && chunk["usage"].isObject()) {
+        usage_obj = chunk["usage"];
+    }
+
+    const Json::Value& choices = chunk["choices"];
+    if (!choices.isArray() || choices.empty()) return;
+    const Json::Value& delta = choices[0]["delta"];
+    if (!delta.isObject() || !delta["content"].isString()) return;
+
+    std::string piece = delta["content"].asString();
+    if (piece.empty()) return;
+    content += piece;
+    if (on_token) on_token(piece);
+}
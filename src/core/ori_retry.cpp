@@ -0,0 +1,202 @@
+#include "ori_retry.h"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <random>
+
+#ifdef CURL_FOUND
+#include <curl/curl.h>
+#endif
+
+namespace {
+long long steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long long unix_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = 0, end = s.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(s[begin]))) begin++;
+    while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1]))) end--;
+    return s.substr(begin, end - begin);
+}
+
+bool iequals(const std::string& a, const char* b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) return false;
+    }
+    return i == a.size() && !b[i];
+}
+
+bool allDigits(const std::string& s) {
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+long random_below(long bound) {
+    if (bound <= 0) return 0;
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    return std::uniform_int_distribution<long>(0, bound)(rng);
+}
+}
+
+long parseRetryAfter(const std::string& raw) {
+    std::string value = trim(raw);
+    if (value.empty()) return -1;
+    if (allDigits(value)) {
+        return value.size() > 6 ? -1 : std::stol(value) * 1000;
+    }
+#ifdef CURL_FOUND
+    time_t when = curl_getdate(value.c_str(), nullptr);
+    if (when != -1) {
+        long long delta = static_cast<long long>(when) * 1000 - unix_ms();
+        return delta > 0 ? static_cast<long>(delta) : 0;
+    }
+#endif
+    return -1;
+}
+
+size_t RetryHints::headerCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    size_t total = size * nitems;
+    RetryHints* hints = static_cast<RetryHints*>(userdata);
+    std::string line(buffer, total);
+
+    // A new status line starts a new response (e.g. after a redirect)
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        hints->reset();
+        return total;
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) return total;
+    std::string name = trim(line.substr(0, colon));
+    std::string value = trim(line.substr(colon + 1));
+
+    if (iequals(name, "retry-after")) {
+        long ms = parseRetryAfter(value);
+        if (ms >= 0) hints->retry_after_ms = ms;
+    } else if (iequals(name, "x-ratelimit-reset") && allDigits(value) && value.size() <= 15) {
+        // OpenRouter sends epoch milliseconds; other providers send epoch seconds
+        long long reset = std::stoll(value);
+        if (reset < 100000000000LL) reset *= 1000;
+        long long delta = reset - unix_ms();
+        hints->rate_limit_reset_ms = delta > 0 ? static_cast<long>(std::min<long long>(delta, LONG_MAX)) : 0;
+    }
+    return total;
+}
+
+long backoffDelayMs(int attempt, const RetryPolicy& policy, long retry_after_ms) {
+    if (retry_after_ms >= 0) {
+        return retry_after_ms + random_below(policy.base_delay_ms);
+    }
+    long window = policy.base_delay_ms;
+    for (int i = 1; i < attempt && window < policy.max_delay_ms; ++i) {
+        window *= 2;
+    }
+    return random_below(std::min(window, policy.max_delay_ms));
+}
+
+UpstreamHealth& UpstreamHealth::instance() {
+    static UpstreamHealth health;
+    return health;
+}
+
+long UpstreamHealth::admit(const std::string& model) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Breaker& b = breakers[model];
+    if (b.state == State::Closed) return 0;
+
+    long long now = steady_ms();
+    if (b.state == State::Open && now >= b.open_until_ms) {
+        b.state = State::HalfOpen;
+        b.probe_in_flight = false;
+    }
+    if (b.state == State::HalfOpen && !b.probe_in_flight) {
+        b.probe_in_flight = true;
+        return 0;
+    }
+    fast_failures++;
+    // Half-open with a probe already out: try again shortly
+    return b.state == State::Open ? static_cast<long>(b.open_until_ms - now) : 1000;
+}
+
+void UpstreamHealth::record(const std::string& model, Outcome outcome, const std::string& detail) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Breaker& b = breakers[model];
+    bool was_probe = b.state == State::HalfOpen;
+    b.probe_in_flight = false;
+
+    if (outcome == Outcome::Success) {
+        b.state = State::Closed;
+        b.consecutive_failures = 0;
+        b.times_opened = 0;
+        return;
+    }
+    if (outcome == Outcome::Neutral) return;
+
+    b.consecutive_failures++;
+    b.last_error = detail;
+    if (was_probe || b.consecutive_failures >= FAILURE_THRESHOLD) {
+        long open_ms = BASE_OPEN_MS;
+        for (int i = 0; i < b.times_opened && open_ms < MAX_OPEN_MS; ++i) {
+            open_ms *= 2;
+        }
+        b.times_opened++;
+        b.state = State::Open;
+        b.open_until_ms = steady_ms() + std::min(open_ms, MAX_OPEN_MS);
+    }
+}
+
+void UpstreamHealth::recordRetry(const std::string& model, const std::string& reason, long delay_ms) {
+    total_retries++;
+    std::lock_guard<std::mutex> lock(mutex);
+    Breaker& b = breakers[model];
+    b.retries++;
+    b.last_retry_reason = reason;
+    b.last_retry_delay_ms = delay_ms;
+}
+
+void UpstreamHealth::recordHedge(bool won) {
+    if (won) {
+        hedges_won++;
+    } else {
+        hedges_fired++;
+    }
+}
+
+Json::Value UpstreamHealth::snapshot() const {
+    Json::Value root;
+    root["retries_total"] = static_cast<Json::UInt64>(total_retries.load());
+    root["fast_failures_total"] = static_cast<Json::UInt64>(fast_failures.load());
+    root["hedges_fired"] = static_cast<Json::UInt64>(hedges_fired.load());
+    root["hedges_won"] = static_cast<Json::UInt64>(hedges_won.load());
+    Json::Value models(Json::objectValue);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    long long now = steady_ms();
+    for (const auto& entry : breakers) {
+        const Breaker& b = entry.second;
+        Json::Value item;
+        switch (b.state) {
+            case State::Closed: item["state"] = "closed"; break;
+            case State::Open: item["state"] = now >= b.open_until_ms ? "half_open" : "open"; break;
+            case State::HalfOpen: item["state"] = "half_open"; break;
+        }
+        item["consecutive_failures"] = b.consecutive_failures;
+        item["open_remaining_ms"] = static_cast<Json::Int64>(
+            b.state == State::Open && b.open_until_ms > now ? b.open_until_ms - now : 0);
+        item["last_error"] = b.last_error;
+        item["retries"] = static_cast<Json::UInt64>(b.retries);
+        item["last_retry_reason"] = b.last_retry_reason;
+        item["last_retry_delay_ms"] = static_cast<Json::Int64>(b.last_retry_delay_ms);
+        models[entry.first] = item;
+    }
+    root["models"] = models;
+    return root;
+}
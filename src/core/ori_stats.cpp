@@ -0,0 +1,219 @@
+#include "ori_stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+namespace {
+// Upper bounds of the latency histogram buckets; the last bucket is open
+const double HISTOGRAM_BOUNDS_MS[] = {100, 250, 500, 1000, 2500, 5000, 10000, 30000};
+const size_t HISTOGRAM_BUCKETS = sizeof(HISTOGRAM_BOUNDS_MS) / sizeof(HISTOGRAM_BOUNDS_MS[0]) + 1;
+
+struct Phase {
+    const char* name;
+    double TransferSample::*field;
+};
+
+const Phase PHASES[] = {
+    {"dns", &TransferSample::dns_ms},
+    {"connect", &TransferSample::connect_ms},
+    {"tls", &TransferSample::tls_ms},
+    {"send", &TransferSample::send_ms},
+    {"wait", &TransferSample::wait_ms},
+    {"receive", &TransferSample::receive_ms},
+    {"total", &TransferSample::total_ms},
+};
+
+struct Summary {
+    size_t count = 0;
+    double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+Summary summarize(std::vector<double> values) {
+    Summary summary;
+    if (values.empty()) return summary;
+    std::sort(values.begin(), values.end());
+    auto pct = [&values](double p) { return values[static_cast<size_t>(p * (values.size() - 1) + 0.5)]; };
+    double sum = 0;
+    for (double v : values) sum += v;
+    summary.count = values.size();
+    summary.mean = sum / values.size();
+    summary.p50 = pct(0.5);
+    summary.p90 = pct(0.9);
+    summary.p99 = pct(0.99);
+    summary.max = values.back();
+    return summary;
+}
+
+Json::Value summaryJson(const Summary& summary) {
+    Json::Value item;
+    item["count"] = static_cast<Json::UInt64>(summary.count);
+    item["mean"] = summary.mean;
+    item["p50"] = summary.p50;
+    item["p90"] = summary.p90;
+    item["p99"] = summary.p99;
+    item["max"] = summary.max;
+    return item;
+}
+
+template <typename Sample>
+std::vector<double> column(const std::deque<Sample>& samples, const std::function<double(const Sample&)>& get) {
+    std::vector<double> values;
+    values.reserve(samples.size());
+    for (const auto& sample : samples) values.push_back(get(sample));
+    return values;
+}
+
+std::vector<size_t> histogram(const std::vector<double>& values) {
+    std::vector<size_t> counts(HISTOGRAM_BUCKETS, 0);
+    for (double v : values) {
+        size_t bucket = 0;
+        while (bucket + 1 < HISTOGRAM_BUCKETS && v > HISTOGRAM_BOUNDS_MS[bucket]) bucket++;
+        counts[bucket]++;
+    }
+    return counts;
+}
+}
+
+RequestStats& RequestStats::instance() {
+    static RequestStats stats;
+    return stats;
+}
+
+void RequestStats::recordTransfer(TransferSample sample) {
+    std::lock_guard<std::mutex> lock(mutex);
+    transfers.push_back(std::move(sample));
+    if (transfers.size() > MAX_TRANSFERS) transfers.pop_front();
+    transfers_total++;
+}
+
+void RequestStats::recordQuery(QuerySample sample) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queries.push_back(std::move(sample));
+    if (queries.size() > MAX_QUERIES) queries.pop_front();
+    queries_total++;
+}
+
+Json::Value RequestStats::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Json::Value root;
+    root["transfers_total"] = static_cast<Json::UInt64>(transfers_total);
+    root["queries_total"] = static_cast<Json::UInt64>(queries_total);
+
+    Json::Value& window = root["window"];
+    window["transfers"] = static_cast<Json::UInt64>(transfers.size());
+    window["queries"] = static_cast<Json::UInt64>(queries.size());
+    unsigned long long new_connections = 0, bytes_up = 0, bytes_down = 0;
+    for (const auto& t : transfers) {
+        if (t.new_connection) new_connections++;
+        bytes_up += t.bytes_up;
+        bytes_down += t.bytes_down;
+    }
+    window["new_connections"] = static_cast<Json::UInt64>(new_connections);
+    window["bytes_up"] = static_cast<Json::UInt64>(bytes_up);
+    window["bytes_down"] = static_cast<Json::UInt64>(bytes_down);
+
+    Json::Value& phases = root["phases_ms"];
+    for (const auto& phase : PHASES) {
+        auto field = phase.field;
+        phases[phase.name] = summaryJson(summarize(column<TransferSample>(transfers,
+            [field](const TransferSample& t) { return t.*field; })));
+    }
+
+    unsigned long long failed = 0, retries = 0;
+    long long prompt_tokens = 0, completion_tokens = 0, cached_tokens = 0;
+    for (const auto& q : queries) {
+        if (!q.ok) failed++;
+        retries += q.retries;
+        if (q.prompt_tokens > 0) prompt_tokens += q.prompt_tokens;
+        if (q.completion_tokens > 0) completion_tokens += q.completion_tokens;
+        cached_tokens += q.cached_tokens;
+    }
+    window["failed_queries"] = static_cast<Json::UInt64>(failed);
+    window["retries"] = static_cast<Json::UInt64>(retries);
+    window["prompt_tokens"] = static_cast<Json::Int64>(prompt_tokens);
+    window["completion_tokens"] = static_cast<Json::Int64>(completion_tokens);
+    window["cached_tokens"] = static_cast<Json::Int64>(cached_tokens);
+
+    std::vector<double> latencies = column<QuerySample>(queries, [](const QuerySample& q) { return q.total_ms; });
+    root["query_ms"] = summaryJson(summarize(latencies));
+    Json::Value& buckets = root["query_histogram"];
+    buckets = Json::Value(Json::arrayValue);
+    std::vector<size_t> counts = histogram(latencies);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        Json::Value bucket;
+        bucket["le_ms"] = i + 1 < HISTOGRAM_BUCKETS ? Json::Value(static_cast<Json::UInt64>(HISTOGRAM_BOUNDS_MS[i]))
+                                                    : Json::Value("inf");
+        bucket["count"] = static_cast<Json::UInt64>(counts[i]);
+        buckets.append(bucket);
+    }
+
+    if (!transfers.empty()) {
+        const TransferSample& t = transfers.back();
+        Json::Value& last = root["last_transfer"];
+        last["model"] = t.model;
+        last["attempt"] = t.attempt;
+        last["http_code"] = static_cast<Json::Int64>(t.http_code);
+        last["curl_result"] = t.curl_result;
+        last["used"] = t.used;
+        last["new_connection"] = t.new_connection;
+        for (const auto& phase : PHASES) last[std::string(phase.name) + "_ms"] = t.*(phase.field);
+        last["bytes_up"] = static_cast<Json::UInt64>(t.bytes_up);
+        last["bytes_down"] = static_cast<Json::UInt64>(t.bytes_down);
+    }
+    return root;
+}
+
+std::string RequestStats::report() const {
+    Json::Value stats = snapshot();
+    const Json::Value& window = stats["window"];
+    if (window["transfers"].asUInt64() == 0) {
+        return "No requests yet.\n";
+    }
+
+    std::ostringstream out;
+    char line[160];
+    out << "Last " << window["transfers"].asUInt64() << " transfers (" << window["new_connections"].asUInt64()
+        << " on new connections), " << window["queries"].asUInt64() << " queries ("
+        << window["failed_queries"].asUInt64() << " failed, " << window["retries"].asUInt64() << " retries)\n";
+    std::snprintf(line, sizeof(line), "%-9s %9s %9s %9s %9s  (ms)\n", "phase", "p50", "p90", "p99", "max");
+    out << line;
+    for (const auto& phase : PHASES) {
+        const Json::Value& s = stats["phases_ms"][phase.name];
+        std::snprintf(line, sizeof(line), "%-9s %9.1f %9.1f %9.1f %9.1f\n", phase.name, s["p50"].asDouble(),
+                      s["p90"].asDouble(), s["p99"].asDouble(), s["max"].asDouble());
+        out << line;
+    }
+
+    if (window["queries"].asUInt64() > 0) {
+        const Json::Value& q = stats["query_ms"];
+        std::snprintf(line, sizeof(line), "%-9s %9.1f %9.1f %9.1f %9.1f\n", "query", q["p50"].asDouble(),
+                      q["p90"].asDouble(), q["p99"].asDouble(), q["max"].asDouble());
+        out << line;
+        out << "Query latency:";
+        for (const auto& bucket : stats["query_histogram"]) {
+            if (bucket["count"].asUInt64() == 0) continue;
+            out << "  " << (bucket["le_ms"].isString() ? ">30000" : "<=" + bucket["le_ms"].asString()) << "ms "
+                << bucket["count"].asUInt64();
+        }
+        out << "\n";
+    }
+
+    long long prompt = window["prompt_tokens"].asInt64();
+    long long cached = window["cached_tokens"].asInt64();
+    out << "Tokens: " << prompt << " prompt (" << cached << " cached";
+    if (prompt > 0) out << ", " << (cached * 100 / prompt) << "%";
+    out << "), " << window["completion_tokens"].asInt64() << " completion\n";
+    out << "Bytes: " << window["bytes_up"].asUInt64() << " sent, " << window["bytes_down"].asUInt64()
+        << " received on the wire\n";
+
+    const Json::Value& last = stats["last_transfer"];
+    std::snprintf(line, sizeof(line),
+                  "Last: %s HTTP %ld, dns %.1f connect %.1f tls %.1f send %.1f wait %.1f receive %.1f total %.1f ms\n",
+                  last["model"].asCString(), static_cast<long>(last["http_code"].asInt64()), last["dns_ms"].asDouble(),
+                  last["connect_ms"].asDouble(), last["tls_ms"].asDouble(), last["send_ms"].asDouble(),
+                  last["wait_ms"].asDouble(), last["receive_ms"].asDouble(), last["total_ms"].asDouble());
+    out << line;
+    return out.str();
+}
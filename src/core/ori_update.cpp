@@ -0,0 +1,146 @@
+#include "ori_update.h"
+#include "ori_net.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <json/json.h>
+
+namespace {
+const char* const VERSION_URL = "https://raw.githubusercontent.com/piratheon/ORI/refs/heads/main/.version";
+const char* const BUILTIN_VERSION = "1.1.4";
+// A version file is a few bytes; anything longer is not one
+const size_t MAX_VERSION_BYTES = 64;
+
+long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string trimVersion(std::string text) {
+    text.erase(text.find_last_not_of(" \n\r\t") + 1);
+    text.erase(0, text.find_first_not_of(" \n\r\t"));
+    return text.size() > MAX_VERSION_BYTES ? "" : text;
+}
+
+#ifdef CURL_FOUND
+size_t collect(void* contents, size_t size, size_t nmemb, std::string* out) {
+    size_t total = size * nmemb;
+    if (out->size() + total > MAX_VERSION_BYTES * 4) return 0;
+    out->append(static_cast<char*>(contents), total);
+    return total;
+}
+
+// Set up a version fetch on a pooled handle; the body lands in `out`
+void configureFetch(CURL* curl, std::string* out, long timeout_ms) {
+    curl_easy_setopt(curl, CURLOPT_URL, VERSION_URL);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, collect);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, out);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, timeout_ms < 2000 ? timeout_ms : 2000L);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "OriAssistant/1.0");
+}
+
+std::string fetchResult(CURL* curl, CURLcode res, const std::string& body) {
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    return (res == CURLE_OK && http_code == 200) ? trimVersion(body) : "";
+}
+#endif
+}
+
+UpdateChecker::UpdateChecker() : state(std::make_shared<State>()) {}
+
+std::string UpdateChecker::currentVersion() {
+    std::string current_version = BUILTIN_VERSION;
+    std::ifstream version_file(".version");
+    if (version_file.is_open()) {
+        std::getline(version_file, current_version);
+    }
+    return trimVersion(current_version);
+}
+
+void UpdateChecker::offer(State& state, const std::string& latest) {
+    if (latest.empty() || latest == currentVersion()) return;
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.latest = latest;
+}
+
+std::string UpdateChecker::takeNotice() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->latest.empty() || state->notified) return "";
+    state->notified = true;
+    return "A new version of Ori is available: " + state->latest;
+}
+
+bool UpdateChecker::noticePending() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return !state->latest.empty() && !state->notified;
+}
+
+void UpdateChecker::writeCache(const std::string& cache_path, const std::string& latest) {
+    if (cache_path.empty()) return;
+    Json::Value root;
+    root["checked_at"] = static_cast<Json::Int64>(unix_now());
+    root["latest"] = latest;
+    // Write then rename so a concurrent start never reads half a file
+    std::string tmp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(tmp_path);
+        if (!out) return;
+        out << root.toStyledString();
+    }
+    std::rename(tmp_path.c_str(), cache_path.c_str());
+}
+
+void UpdateChecker::startBackground(const std::string& cache_path) {
+    Json::Value cached;
+    std::ifstream in(cache_path);
+    if (in) {
+        Json::CharReaderBuilder reader;
+        std::string errors;
+        if (Json::parseFromStream(reader, in, &cached, &errors) && cached.isObject()) {
+            long long age = unix_now() - cached.get("checked_at", 0).asInt64();
+            if (age >= 0 && age < CHECK_TTL_SECONDS) {
+                offer(*state, cached.get("latest", "").asString());
+                return;
+            }
+        }
+    }
+
+#ifdef CURL_FOUND
+    CURL* curl = ConnectionPool::instance().acquire();
+    if (!curl) return;
+    auto body = std::make_shared<std::string>();
+    configureFetch(curl, body.get(), BACKGROUND_TIMEOUT_MS);
+    std::shared_ptr<State> shared_state = state;
+    NetworkLoop& loop = NetworkLoop::instance();
+    loop.post([&loop, curl, body, shared_state, cache_path]() {
+        loop.start(curl, [curl, body, shared_state, cache_path](CURLcode res) {
+            std::string latest = fetchResult(curl, res, *body);
+            ConnectionPool::instance().release(curl);
+            writeCache(cache_path, latest);
+            offer(*shared_state, latest);
+        });
+    });
+#endif
+}
+
+std::string UpdateChecker::fetchLatest(long timeout_ms, const std::string& cache_path) {
+#ifdef CURL_FOUND
+    ConnectionPool& pool = ConnectionPool::instance();
+    CURL* curl = pool.acquire();
+    if (!curl) return "";
+    std::string body;
+    configureFetch(curl, &body, timeout_ms);
+    CURLcode res = curl_easy_perform(curl);
+    std::string latest = fetchResult(curl, res, body);
+    pool.release(curl);
+    writeCache(cache_path, latest);
+    return latest;
+#else
+    (void)timeout_ms;
+    (void)cache_path;
+    return "";
+#endif
+}
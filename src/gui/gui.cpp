@@ -8,6 +8,11 @@
 #include <map>
 #include "json/json.h"
 #include "ori_core.h"
+#include "ori_retry.h"
+#include "ori_net.h"
+#include "ori_stats.h"
+#include "ori_metrics.h"
+#include "ori_jobs.h"
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
@@ -17,6 +22,11 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
 #define SERVER_CERT_FILE "cert.pem"
@@ -51,17 +61,134 @@ extern const char _binary_index_html_end[];
 extern const char _binary_favicon_svg_start[];
 extern const char _binary_favicon_svg_end[];
 
-// In-memory chat history
+// In-memory chat history (handlers run on httplib's worker threads)
 std::map<std::string, std::vector<std::pair<std::string, std::string>>> chat_sessions;
 long long next_session_id = 0;
+std::mutex chat_sessions_mutex;
+// Mirrors of chat_sessions' size for /metrics, so a scrape never takes the lock
+std::atomic<long long> chat_session_count{0};
+std::atomic<long long> chat_session_bytes{0};
+
+// Most log bytes one /api/exec_log reply carries; the page asks again for the rest
+const size_t EXEC_LOG_CHUNK = 256 * 1024;
+// An idle /api/exec_stream sends a comment this often to notice a closed page
+const std::chrono::milliseconds EXEC_STREAM_KEEPALIVE(15000);
+// httplib's worker threads. Each open /api/exec_stream keeps one busy, so
+// the pool is sized here rather than left at max(8, cores - 1), and at most
+// a quarter of it may hold streams.
+const size_t GUI_WORKER_THREADS = std::max(16u, std::thread::hardware_concurrency() * 2);
+const long long exec_stream_limit = static_cast<long long>(GUI_WORKER_THREADS / 4);
+std::atomic<long long> exec_streams_open{0};
+
+// Where an /api/exec_stream is in one command's log
+struct ExecStreamPosition {
+    size_t offset = 0;
+    size_t seen = 0;        // log size at the last read
+    bool caught_up = false; // the last read had nothing new to send
+};
+
+// "3:120,5:0": what a reconnecting stream resumes from
+std::string exec_stream_event_id(const std::map<std::string, ExecStreamPosition>& positions) {
+    std::string id;
+    for (const auto& entry : positions) {
+        id += (id.empty() ? "" : ",") + entry.first + ":" + std::to_string(entry.second.offset);
+    }
+    return id;
+}
 
-struct CommandInfo {
-    pid_t pid;
-    std::string log_path;
-    int status;
+// Requests per route for /metrics, keyed by "METHOD route"
+struct RouteMetrics {
+    std::atomic<unsigned long long> by_status_class[6] = {}; // index 2 counts 2xx...
+    LatencyHistogram duration;
+    bool used() const {
+        unsigned long long total = 0;
+        for (const auto& count : by_status_class) total += count.load(std::memory_order_relaxed);
+        return total > 0;
+    }
+};
+MetricFamily<RouteMetrics> route_metrics;
+std::atomic<long long> prompts_in_flight{0};
+// Set by the pre-routing handler and cleared once used. httplib answers a
+// malformed request (400, 414) without routing it, so there it stays unset.
+thread_local std::chrono::steady_clock::time_point request_started;
+
+// Counts a /api/prompt or /api/prompt_stream call as in flight while alive
+struct PromptInFlight {
+    PromptInFlight() { prompts_in_flight.fetch_add(1, std::memory_order_relaxed); }
+    ~PromptInFlight() { prompts_in_flight.fetch_sub(1, std::memory_order_relaxed); }
 };
-std::map<std::string, CommandInfo> running_commands;
-long long next_command_id = 0;
+
+// The post-routing handler, which httplib calls without a lock (its logger
+// runs under one process-wide mutex). A streamed body is still being written
+// then, so its duration is recorded when httplib releases the provider.
+void record_request_metrics(const httplib::Request& req, httplib::Response& res) {
+    std::string route = req.matched_route;
+    if (route.empty()) {
+        route = "unmatched";
+    } else if (route[0] == '(') {
+        route = "static"; // the file-extension regex
+    }
+    RouteMetrics& metrics = route_metrics.get(req.method + " " + route);
+    int status_class = res.status / 100;
+    if (status_class < 1 || status_class > 5) status_class = 5;
+    metrics.by_status_class[status_class].fetch_add(1, std::memory_order_relaxed);
+    const auto started = request_started;
+    request_started = std::chrono::steady_clock::time_point();
+    if (started == std::chrono::steady_clock::time_point()) return;
+    auto observe = [&metrics, started] {
+        metrics.duration.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+    };
+    if (!res.content_provider_) {
+        observe();
+        return;
+    }
+    auto release = std::move(res.content_provider_resource_releaser_);
+    res.content_provider_resource_releaser_ = [release, observe](bool success) {
+        if (release) release(success);
+        observe();
+    };
+}
+
+std::string render_metrics() {
+    std::string out;
+    metricHeader(out, "ori_http_requests_total", "counter", "GUI server requests by route and status class.");
+    route_metrics.forEach([&out](const std::string& key, const RouteMetrics& m) {
+        size_t space = key.find(' ');
+        const std::string labels = "method=\"" + metricLabel(key.substr(0, space)) + "\",route=\"" +
+                                   metricLabel(key.substr(space + 1)) + "\"";
+        for (int status_class = 1; status_class <= 5; ++status_class) {
+            unsigned long long count = m.by_status_class[status_class].load(std::memory_order_relaxed);
+            if (count == 0) continue;
+            out += "ori_http_requests_total{" + labels + ",code=\"" + std::to_string(status_class) + "xx\"} " +
+                   std::to_string(count) + "\n";
+        }
+    });
+    metricHeader(out, "ori_http_request_duration_seconds", "histogram", "GUI server request duration, including streamed bodies.");
+    route_metrics.forEach([&out](const std::string& key, const RouteMetrics& m) {
+        size_t space = key.find(' ');
+        m.duration.render(out, "ori_http_request_duration_seconds", "method=\"" + metricLabel(key.substr(0, space)) +
+                          "\",route=\"" + metricLabel(key.substr(space + 1)) + "\"");
+    });
+    auto gauge = [&out](const char* name, const char* help, long long value) {
+        metricHeader(out, name, "gauge", help);
+        out += std::string(name) + " " + std::to_string(value) + "\n";
+    };
+    gauge("ori_prompt_requests_in_flight", "Prompt requests waiting for a reply.", prompts_in_flight.load());
+    gauge("ori_chat_sessions", "Chat sessions held in memory.", chat_session_count.load());
+    gauge("ori_chat_session_bytes", "Bytes of prompts and replies held in chat sessions.", chat_session_bytes.load());
+    gauge("ori_running_commands", "Commands started through /api/exec that have not exited.", CommandJobs::instance().runningCount());
+    renderProcessMetrics(out);
+    return out;
+}
+
+// Store one exchange of a session, keeping the /metrics mirrors in step
+void record_chat_turn(const std::string& session_id, const std::string& prompt, const std::string& response) {
+    std::lock_guard<std::mutex> lock(chat_sessions_mutex);
+    auto& turns = chat_sessions[session_id];
+    if (turns.empty()) chat_session_count.fetch_add(1, std::memory_order_relaxed);
+    turns.push_back({prompt, response});
+    chat_session_bytes.fetch_add(static_cast<long long>(prompt.size() + response.size()), std::memory_order_relaxed);
+}
 
 std::string generate_session_name(const std::string& prompt) {
     std::stringstream ss(prompt);
@@ -73,6 +200,39 @@ std::string generate_session_name(const std::string& prompt) {
     return word1 + " " + word2;
 }
 
+// Set up a per-request assistant with the GUI system prompt and the model
+// picked in the browser. Returns false if the API key could not be loaded.
+bool prepare_gui_assistant(OriAssistant& assistant, const std::string& model) {
+    assistant.api->setSystemPrompt(GUI_SYSTEM_PROMPT);
+    assistant.api->setIsGui(true);
+    if (!assistant.initialize()) {
+        if (g_debug_enabled_in_gui_mode) {
+            std::cerr << "Debug: Assistant initialization failed." << std::endl;
+        }
+        return false;
+    }
+
+    // Apply model selection after initialization so config does not override it
+    if (!model.empty()) {
+        assistant.api->setModel(model);
+        if (g_debug_enabled_in_gui_mode) {
+            std::cout << "Debug: Model set to " << model << std::endl;
+        }
+    }
+    return true;
+}
+
+// Write one server-sent event; returns false once the browser has gone away.
+// A non-empty id is what the browser sends back as Last-Event-ID on reconnect.
+bool write_sse_event(httplib::DataSink& sink, const std::string& event, const Json::Value& data,
+                     const std::string& id = "") {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string frame = (id.empty() ? "" : "id: " + id + "\n") + "event: " + event + "\ndata: " +
+                        Json::writeString(builder, data) + "\n\n";
+    return sink.is_writable() && sink.write(frame.data(), frame.size());
+}
+
 std::string get_mime_type(const std::string& path) {
     auto ext_pos = path.find_last_of('.');
     if (ext_pos != std::string::npos) {
@@ -126,6 +286,19 @@ void serve_static_file(const httplib::Request& req, httplib::Response& res) {
 void ori::start_gui(int port)
 {
     httplib::Server svr;
+    svr.new_task_queue = [] { return new httplib::ThreadPool(GUI_WORKER_THREADS); };
+    // Replies are small writes; don't let Nagle hold them behind a delayed ACK
+    svr.set_tcp_nodelay(true);
+    svr.set_pre_routing_handler([](const httplib::Request &, httplib::Response &) {
+        request_started = std::chrono::steady_clock::now();
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+    svr.set_post_routing_handler(record_request_metrics);
+
+    // Prometheus text exposition format
+    svr.Get("/metrics", [](const httplib::Request &, httplib::Response &res) {
+        res.set_content(render_metrics(), "text/plain; version=0.0.4");
+    });
 
     svr.Get("/", serve_static_file);
     svr.Get(R"((/.*\.html|/.*\.js|/.*\.css|/.*\.svg|/.*\.png|/.*\.jpg|/.*\.jpeg|/.*\.json|/.*\.wasm|/.*\.woff2|/.*\.ttf))", serve_static_file);
@@ -147,8 +320,21 @@ void ori::start_gui(int port)
         res.set_content(models.toStyledString(), "application/json");
     });
     
+    // Retry counters and per-model circuit breaker state
+    svr.Get("/api/upstream_status", [](const httplib::Request &, httplib::Response &res) {
+        Json::Value root = UpstreamHealth::instance().snapshot();
+        root["transfer"] = TransferCounters::instance().snapshot();
+        root["prompt_cache"] = PromptCacheCounters::instance().snapshot();
+        res.set_content(root.toStyledString(), "application/json");
+    });
+
+    svr.Get("/api/stats", [](const httplib::Request &, httplib::Response &res) {
+        res.set_content(RequestStats::instance().snapshot().toStyledString(), "application/json");
+    });
+
     svr.Get("/api/chats", [](const httplib::Request &, httplib::Response &res) {
         Json::Value root(Json::arrayValue);
+        std::lock_guard<std::mutex> lock(chat_sessions_mutex);
         for (const auto& session : chat_sessions) {
             Json::Value item;
             item["id"] = session.first;
@@ -161,6 +347,7 @@ void ori::start_gui(int port)
     svr.Get("/api/history", [](const httplib::Request &req, httplib::Response &res) {
         std::string session_id = req.get_param_value("session_id");
         Json::Value root(Json::arrayValue);
+        std::lock_guard<std::mutex> lock(chat_sessions_mutex);
         if (chat_sessions.count(session_id)) {
             for (const auto& entry : chat_sessions[session_id]) {
                 Json::Value item;
@@ -173,7 +360,10 @@ void ori::start_gui(int port)
     });
 
     svr.Get("/api/clear_chats", [](const httplib::Request &, httplib::Response &res) {
+        std::lock_guard<std::mutex> lock(chat_sessions_mutex);
         chat_sessions.clear();
+        chat_session_count = 0;
+        chat_session_bytes = 0;
         next_session_id = 0;
         res.set_content("{}", "application/json");
     });
@@ -191,37 +381,26 @@ void ori::start_gui(int port)
         }
 
         if (session_id.empty()) {
+            std::lock_guard<std::mutex> lock(chat_sessions_mutex);
             session_id = std::to_string(next_session_id++);
         }
 
+        PromptInFlight in_flight;
         OriAssistant assistant;
-        assistant.api->setSystemPrompt(GUI_SYSTEM_PROMPT);
-        assistant.api->setIsGui(true);
-        if (!assistant.initialize()) {
+        if (!prepare_gui_assistant(assistant, model)) {
             Json::Value err;
             err["error"] = "Failed to initialize assistant";
             res.set_content(err.toStyledString(), "application/json");
-            if (g_debug_enabled_in_gui_mode) {
-                std::cerr << "Debug: Assistant initialization failed for /api/prompt." << std::endl;
-            }
             return;
         }
 
-        // Apply model selection after initialization so config does not override it
-        if (!model.empty()) {
-            assistant.api->setModel(model);
-            if (g_debug_enabled_in_gui_mode) {
-                std::cout << "Debug: Model set to " << model << std::endl;
-            }
-        }
-
         std::string response = assistant.api->sendQuery(prompt);
         
         if (g_debug_enabled_in_gui_mode) {
             std::cout << "Debug: API response for prompt '" << prompt << "': " << response.substr(0, std::min((int)response.length(), 100)) << "..." << std::endl; // Log first 100 chars
         }
         
-        chat_sessions[session_id].push_back({prompt, response});
+        record_chat_turn(session_id, prompt, response);
 
         Json::Value result;
         if (response.rfind("API Error", 0) == 0) {
@@ -234,36 +413,215 @@ void ori::start_gui(int port)
         res.set_content(result.toStyledString(), "application/json");
     });
 
+    // Same as /api/prompt, but replies with server-sent events: one "token"
+    // event per model delta, then a "done" event carrying the session id and
+    // the full text (or an error) once the reply is stored in chat_sessions.
+    svr.Post("/api/prompt_stream", [](const httplib::Request &req, httplib::Response &res) {
+        Json::Value root;
+        Json::Reader reader;
+        reader.parse(req.body, root);
+        std::string prompt = root["prompt"].asString();
+        std::string session_id = root["session_id"].asString();
+        std::string model = root["model"].asString();
+
+        if (g_debug_enabled_in_gui_mode) {
+            std::cout << "Debug: Received /api/prompt_stream request. Prompt: '" << prompt << "', Session ID: '" << session_id << "', Model: '" << model << "'" << std::endl;
+        }
+
+        if (session_id.empty()) {
+            std::lock_guard<std::mutex> lock(chat_sessions_mutex);
+            session_id = std::to_string(next_session_id++);
+        }
+
+        res.set_header("Cache-Control", "no-cache");
+        res.set_header("X-Accel-Buffering", "no");
+        res.set_chunked_content_provider("text/event-stream",
+            [prompt, session_id, model](size_t, httplib::DataSink &sink) {
+                Json::Value result;
+                result["session_id"] = session_id;
+
+                PromptInFlight in_flight;
+                OriAssistant assistant;
+                if (!prepare_gui_assistant(assistant, model)) {
+                    result["error"] = "Failed to initialize assistant";
+                    write_sse_event(sink, "done", result);
+                    sink.done();
+                    return true;
+                }
+
+                bool client_connected = true;
+                std::string response = assistant.api->sendQuery(prompt, [&](const std::string& delta) {
+                    if (!client_connected) return;
+                    Json::Value token;
+                    token["token"] = delta;
+                    client_connected = write_sse_event(sink, "token", token);
+                });
+
+                if (g_debug_enabled_in_gui_mode) {
+                    std::cout << "Debug: Streamed response for prompt '" << prompt << "': " << response.substr(0, std::min((int)response.length(), 100)) << "..." << std::endl;
+                }
+
+                // Record the reply even if the tab was closed mid-stream
+                record_chat_turn(session_id, prompt, response);
+
+                if (response.rfind("API Error", 0) == 0) {
+                    result["error"] = response;
+                } else {
+                    result["response"] = response;
+                }
+                if (client_connected) {
+                    write_sse_event(sink, "done", result);
+                }
+                sink.done();
+                return true;
+            });
+    });
+
     svr.Post("/api/exec", [](const httplib::Request &req, httplib::Response &res) {
         Json::Value root;
         Json::Reader reader;
         reader.parse(req.body, root);
         std::string command = root["command"].asString();
-        std::string command_id = std::to_string(next_command_id++);
-        std::string log_path = "/tmp/ori_exec_" + command_id + ".log";
-        
-        pid_t pid = fork();
-        if (pid == -1) {
+        std::string command_id;
+        std::string error;
+        if (!CommandJobs::instance().start(command, command_id, error)) {
             Json::Value err;
-            err["error"] = "Failed to fork process";
+            err["error"] = error;
+            res.set_content(err.toStyledString(), "application/json");
+            return;
+        }
+        Json::Value result;
+        result["command_id"] = command_id;
+        res.set_content(result.toStyledString(), "application/json");
+    });
+
+    // Output from byte `offset` on, plus status and, once finished, exit code
+    // and duration; pass the returned offset to the next call
+    svr.Get("/api/exec_log", [](const httplib::Request &req, httplib::Response &res) {
+        std::string command_id = req.get_param_value("command_id");
+        size_t offset = std::strtoull(req.get_param_value("offset").c_str(), nullptr, 10);
+        std::string log;
+        Json::Value result;
+        if (!CommandJobs::instance().read(command_id, offset, EXEC_LOG_CHUNK, log, result)) {
+            Json::Value err;
+            err["error"] = "Unknown command_id: " + command_id;
+            res.status = 404;
             res.set_content(err.toStyledString(), "application/json");
             return;
-        } else if (pid == 0) { // Child process
-            int log_fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            if (log_fd == -1) {
-                exit(1);
-            }
-            dup2(log_fd, STDOUT_FILENO);
-            dup2(log_fd, STDERR_FILENO);
-            close(log_fd);
-            execl("/bin/sh", "sh", "-c", command.c_str(), NULL);
-            exit(127); // If execl fails
-        } else { // Parent process
-            running_commands[command_id] = {pid, log_path, 0};
-            Json::Value result;
-            result["command_id"] = command_id;
-            res.set_content(result.toStyledString(), "application/json");
         }
+        result["command_id"] = command_id;
+        result["log"] = log;
+        res.set_content(result.toStyledString(), "application/json");
+    });
+
+    // Server-sent events for the page's /api/exec commands, all on one
+    // connection: "output" events carry a command's log bytes as it writes
+    // them, then an "exit" event carries the state /api/exec_log reports (or
+    // "expired"). `command_ids` lists them as id:offset pairs ("3:0,5:1200").
+    // However many pages watch a command, its output is read once; each
+    // stream waits on the supervisor. A stream holds a worker thread, so past
+    // exec_stream_limit the page is told to poll /api/exec_log instead.
+    svr.Get("/api/exec_stream", [](const httplib::Request &req, httplib::Response &res) {
+        // A reconnecting EventSource resumes after the last event it got
+        std::string resume = req.has_header("Last-Event-ID") ? req.get_header_value("Last-Event-ID")
+                                                              : req.get_param_value("command_ids");
+        auto positions = std::make_shared<std::map<std::string, ExecStreamPosition>>();
+        std::stringstream list(resume);
+        std::string item;
+        while (std::getline(list, item, ',')) {
+            size_t colon = item.find(':');
+            std::string id = item.substr(0, colon);
+            if (id.empty()) continue;
+            (*positions)[id].offset = colon == std::string::npos ? 0 : std::strtoull(item.c_str() + colon + 1, nullptr, 10);
+        }
+        if (positions->empty()) {
+            Json::Value err;
+            err["error"] = "No command_ids given";
+            res.status = 400;
+            res.set_content(err.toStyledString(), "application/json");
+            return;
+        }
+        if (exec_streams_open.fetch_add(1) >= exec_stream_limit) {
+            exec_streams_open.fetch_sub(1);
+            Json::Value err;
+            err["error"] = "Too many command streams are open; poll /api/exec_log instead";
+            res.status = 503;
+            res.set_content(err.toStyledString(), "application/json");
+            return;
+        }
+
+        res.set_header("Cache-Control", "no-cache");
+        res.set_header("X-Accel-Buffering", "no");
+        res.set_chunked_content_provider("text/event-stream",
+            [positions](size_t, httplib::DataSink &sink) {
+                CommandJobs& jobs = CommandJobs::instance();
+                std::map<std::string, size_t> waiting; // commands with nothing new at the last read
+                bool all_caught_up = true;
+                for (const auto& entry : *positions) {
+                    waiting[entry.first] = entry.second.seen;
+                    all_caught_up = all_caught_up && entry.second.caught_up;
+                }
+                if (all_caught_up) jobs.waitForOutput(waiting, EXEC_STREAM_KEEPALIVE);
+
+                bool wrote = false;
+                for (auto it = positions->begin(); it != positions->end();) {
+                    const std::string& command_id = it->first;
+                    ExecStreamPosition& position = it->second;
+                    std::string log;
+                    Json::Value state;
+                    if (!jobs.read(command_id, position.offset, EXEC_LOG_CHUNK, log, state)) {
+                        state["command_id"] = command_id;
+                        state["status"] = "expired";
+                        it = positions->erase(it);
+                        if (!write_sse_event(sink, "exit", state, exec_stream_event_id(*positions))) return false;
+                        wrote = true;
+                        continue;
+                    }
+                    position.offset = state["offset"].asUInt64();
+                    position.seen = state["size"].asUInt64();
+                    position.caught_up = log.empty() || position.offset >= position.seen;
+                    bool ended = state["status"].asString() != "running" && position.offset >= position.seen;
+                    if (!log.empty()) {
+                        Json::Value output;
+                        output["command_id"] = command_id;
+                        output["log"] = log;
+                        output["offset"] = state["offset"];
+                        if (!write_sse_event(sink, "output", output, exec_stream_event_id(*positions))) return false;
+                        wrote = true;
+                    }
+                    if (ended) {
+                        state["command_id"] = command_id;
+                        it = positions->erase(it);
+                        if (!write_sse_event(sink, "exit", state, exec_stream_event_id(*positions))) return false;
+                        wrote = true;
+                        continue;
+                    }
+                    ++it;
+                }
+                if (positions->empty()) {
+                    sink.done();
+                } else if (!wrote) {
+                    const std::string keepalive = ": keepalive\n\n";
+                    if (!sink.is_writable() || !sink.write(keepalive.data(), keepalive.size())) return false;
+                }
+                return true;
+            },
+            [](bool) { exec_streams_open.fetch_sub(1); });
+    });
+
+    svr.Post("/api/exec_kill", [](const httplib::Request &req, httplib::Response &res) {
+        Json::Value root;
+        Json::Reader reader;
+        reader.parse(req.body, root);
+        std::string command_id = root["command_id"].asString();
+        Json::Value result;
+        if (!CommandJobs::instance().kill(command_id)) {
+            result["error"] = "No running command with id " + command_id;
+            res.status = 404;
+        } else {
+            result["ok"] = true;
+        }
+        res.set_content(result.toStyledString(), "application/json");
     });
 
     // Helper: test whether we can bind to a port (without leaving it bound)
@@ -321,6 +679,21 @@ void ori::start_gui(int port)
         std::cout << "Debug: Initializing HTTP server." << std::endl;
     }
 
+    // Every /api/prompt handler draws from the same connection pool; open it
+    // now so the first prompt does not pay for the TLS handshake.
+    Config warmup_config;
+    ConfigManager().loadConfig(warmup_config);
+    CommandJobs::instance().setRetention(warmup_config.exec_log_retention);
+    CommandJobs::instance().setLimits(execLimitsFrom(warmup_config));
+    BackendProfile warmup_backend;
+    std::string backend_error;
+    if (resolveBackend(warmup_config.backend, warmup_config.backends, warmup_config.api_url, warmup_backend,
+                       backend_error)) {
+        OpenRouterAPI warmup_api;
+        warmup_api.setBackend(warmup_backend);
+        warmup_api.prewarmConnection();
+    }
+
     // Port appears free — start server on the requested port
     if (!svr.listen("0.0.0.0", port)) {
         std::cerr << "Error: svr.listen failed for port " << port << ", errno " << errno << " (" << std::strerror(errno) << ")" << std::endl;
@@ -1,5 +1,6 @@
 #include "ori_core.h"
 #include "ori_gui.h"
+#include "ori_batch.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -7,6 +8,7 @@
 #include <sstream>
 #include <functional>
 #include <unordered_map>
+#include <algorithm>
 
 const std::string SYSTEM_PROMPT = R"ORI_PROMPT(About Me: Ori
 
@@ -57,6 +59,8 @@ For regular shell commands and system operations, I use the [exec] tag.
 Always return commands wrapped in the [exec]...[/exec] tag when you want Ori to run them.
 Do NOT ask the user for explicit confirmation before returning an [exec] block — Ori will execute the command when it receives it.
 
+When one reply contains several [exec] blocks, Ori runs them at the same time, not one after another, and sends all their output back together. Use separate blocks only for commands that do not depend on each other. Steps that must happen in order go in one block joined with && (for example [exec]mkdir -p build && cd build && cmake ..[/exec], never [exec]mkdir build[/exec] followed by [exec]cd build && cmake ..[/exec]).
+
 If a command includes superuser escalation (for example it contains the word "sudo" or "su"), the assistant must still include the [exec] tag but should also include a short human-readable warning line explaining that the command requires elevated privileges and may prompt the user for a password. Ori itself will execute the command and will not ask for a separate "yes" confirmation; it will only warn the user about privilege implications.
 
 Examples (assistant MUST return strictly escaped JSON for [edit] tags and must wrap shell commands in [exec]):
@@ -130,9 +134,13 @@ void showUsage() {
     std::cout << "  -m, --model <model_name>      Specify the AI model to use (overrides config)\n";
     std::cout << "  -p, --port <port_number>      Specify the port for the GUI (overrides config)\n";
     std::cout << "  -d, --debug             Enable debug logging\n"; // Added debug flag
+    std::cout << "  --batch <in.jsonl>      Run every prompt in a JSONL file (requires --out)\n";
+    std::cout << "  --out <out.jsonl>       Append batch results here; rerun to resume\n";
+    std::cout << "  --concurrency <n>       Batch requests in flight at once (default 4)\n";
     std::cout << "\nShell Integration Examples:\n";
     std::cout << "  ori -y 'install nmap for me'\n";
     std::cout << "  ori print current active username\n";
+    std::cout << "  ori --batch prompts.jsonl --out results.jsonl --concurrency 8\n";
     std::cout << "\nIf no options are provided, the interactive assistant will start.\n";
 }
 
@@ -142,25 +150,24 @@ void showVersion() {
 
 void processDirectPrompt(OriAssistant& assistant, const std::string& prompt, bool auto_confirm) {
     // Get response directly without showing the prompt again
-    std::string response = assistant.api->sendQuery(prompt);
-    assistant.handleResponse(response, auto_confirm);
+    assistant.processSingleRequest(prompt, auto_confirm);
 }
 
 
 
 int main(int argc, char* argv[]) {
     std::string executable_path = argv[0];
-    OriAssistant assistant;
-    assistant.setExecutablePath(executable_path);
-    assistant.api->setSystemPrompt(SYSTEM_PROMPT);
-    if (!assistant.initialize()) {
-        std::cerr << "Failed to initialize ORI Terminal Assistant. Please check your API key configuration.\n";
-        return 1;
-    }
 
+    // Parse the command line before touching the config, the API key or
+    // libcurl: --help, --version and --config must stay cheap (shell
+    // integrations call them in loops) and must never prompt for a key.
     bool auto_confirm = false;
     bool gui_mode = false;
     bool port_specified = false;
+    BatchOptions batch;
+    ConfigManager configManager;
+    // Command-line config changes, applied in order once the config file is loaded
+    std::vector<std::function<void(Config&)>> config_overrides;
     std::vector<std::string> args(argv + 1, argv + argc);
     std::string prompt = "";
     int prompt_start_index = -1;
@@ -184,53 +191,82 @@ int main(int argc, char* argv[]) {
         return 1;
     };
     arg_handlers["--no-banner"] = [&](int i, const std::vector<std::string>& args) {
-        assistant.config.no_banner = true;
+        config_overrides.push_back([](Config& config) { config.no_banner = true; });
         return 1;
     };
     arg_handlers["--no-clear"] = [&](int i, const std::vector<std::string>& args) {
-        assistant.config.no_clear = true;
+        config_overrides.push_back([](Config& config) { config.no_clear = true; });
         return 1;
     };
     arg_handlers["-d"] = arg_handlers["--debug"] = [&](int i, const std::vector<std::string>& args) {
-        assistant.config.debug = true;
+        config_overrides.push_back([](Config& config) { config.debug = true; });
         return 1;
     };
     arg_handlers["--check-for-updates"] = [&](int i, const std::vector<std::string>& args) {
+        // Needs the network but neither the config nor the API key
+        OriAssistant assistant;
+        assistant.setExecutablePath(executable_path);
         assistant.checkForUpdates(false);
         return 0;
     };
     arg_handlers["-m"] = arg_handlers["--model"] = [&](int i, const std::vector<std::string>& args) {
         if (i + 1 < args.size()) {
-            assistant.config.model = args[i + 1];
+            std::string model = args[i + 1];
+            config_overrides.push_back([model](Config& config) { config.model = model; });
             return 2;
         }
         return 1;
     };
     arg_handlers["-p"] = arg_handlers["--port"] = [&](int i, const std::vector<std::string>& args) {
         if (i + 1 < args.size()) {
-            assistant.config.port = std::stoi(args[i + 1]);
+            int port = std::stoi(args[i + 1]);
+            config_overrides.push_back([port](Config& config) { config.port = port; });
             port_specified = true;
             return 2;
         }
         return 1;
     };
+    arg_handlers["--batch"] = [&](int i, const std::vector<std::string>& args) {
+        if (i + 1 < args.size()) {
+            batch.input_path = args[i + 1];
+            return 2;
+        }
+        return 1;
+    };
+    arg_handlers["--out"] = [&](int i, const std::vector<std::string>& args) {
+        if (i + 1 < args.size()) {
+            batch.output_path = args[i + 1];
+            return 2;
+        }
+        return 1;
+    };
+    arg_handlers["--concurrency"] = [&](int i, const std::vector<std::string>& args) {
+        if (i + 1 < args.size()) {
+            batch.concurrency = std::stoi(args[i + 1]);
+            return 2;
+        }
+        return 1;
+    };
     arg_handlers["-c"] = arg_handlers["--config"] = [&](int i, const std::vector<std::string>& args) {
         if (i + 1 < args.size()) {
             std::string config_cmd = args[i + 1];
             if (config_cmd == "load" && i + 2 < args.size()) {
-                assistant.configManager.loadExternalConfig(assistant.config, args[i + 2]);
+                std::string path = args[i + 2];
+                config_overrides.push_back([&configManager, path](Config& config) {
+                    configManager.loadExternalConfig(config, path);
+                });
                 return 3;
             } else if (config_cmd == "set" && i + 3 < args.size()) {
-                assistant.configManager.updateConfig(args[i + 2], args[i + 3]);
+                configManager.updateConfig(args[i + 2], args[i + 3]);
                 return 0;
             } else if (config_cmd == "cat") {
                 if (i + 2 < args.size()) {
                     std::string key = args[i + 2];
                     if (key == "all") {
-                        std::string all = assistant.configManager.getAllConfig();
+                        std::string all = configManager.getAllConfig();
                         std::cout << all << std::endl;
                     } else {
-                        std::string val = assistant.configManager.getConfigValue(key);
+                        std::string val = configManager.getConfigValue(key);
                         if (val.empty()) {
                             std::cerr << "Unknown config key: " << key << std::endl;
                             return -1;
@@ -238,7 +274,7 @@ int main(int argc, char* argv[]) {
                         std::cout << val << std::endl;
                     }
                 } else {
-                    std::cout << "Available config keys: port, model, no_banner, no_clear, all" << std::endl;
+                    std::cout << "Available config keys: port, model, no_banner, no_clear, prewarm, stream, context_budget, context_budgets, context_keep_recent, context_compact, cache, cache_ttl, cache_entries, hedge_models, hedge_delay_ms, api_url, compress_requests, prompt_cache, backend, backends, exec_parallelism, exec_output_bytes, exec_output_lines, exec_log_retention, exec_timeout, exec_cpu_seconds, exec_memory_mb, exec_max_output, exec_max_processes, exec_persistent_shell, all" << std::endl;
                     std::cout << "Usage: --config cat <key|all>  (e.g. --config cat model)" << std::endl;
                 }
                 return 0;
@@ -268,9 +304,28 @@ int main(int argc, char* argv[]) {
         return 1; // Exit after warning
     }
 
+    if (!batch.input_path.empty() && batch.output_path.empty()) {
+        std::cerr << "Error: --batch needs --out <results.jsonl>" << std::endl;
+        return 1;
+    }
+
     // Set global g_is_gui_mode *before* initialize() is called
     g_is_gui_mode = gui_mode;
 
+    OriAssistant assistant;
+    assistant.setExecutablePath(executable_path);
+    assistant.api->setSystemPrompt(SYSTEM_PROMPT);
+    bool initialized = assistant.initialize([&config_overrides](Config& config) {
+        for (const auto& apply : config_overrides) apply(config);
+    });
+    if (!initialized) {
+        std::cerr << "Failed to initialize ORI Terminal Assistant. Please check your API key configuration.\n";
+        return 1;
+    }
+
+    // Once per process: the GUI initializes an assistant for every prompt
+    removeStaleSpillFiles(std::max(0, assistant.config.exec_log_retention));
+
     // Set global debug flag for GUI mode
     g_debug_enabled_in_gui_mode = assistant.config.debug && g_is_gui_mode;
 
@@ -279,6 +334,10 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    if (!batch.input_path.empty()) {
+        return runBatch(batch, assistant.config, assistant.api->getBackend(), assistant.api->getApiKey(), SYSTEM_PROMPT);
+    }
+
     if (prompt_start_index != -1) {
         for (int i = prompt_start_index; i < args.size(); ++i) {
             if (!prompt.empty()) prompt += " ";